@@ -16,9 +16,25 @@ LOCAL_PATH := $(call my-dir)
 
 include $(CLEAR_VARS)
 
+LOCAL_MODULE    := libsysprop
+
+LOCAL_SRC_FILES := property_store.cpp prop_transaction.cpp persistent_properties.cpp property_info.cpp prop_stats.cpp \
+                   prop_arena.cpp prop_audit.cpp prop_bionic.cpp property_info_builder.cpp
+
+LOCAL_CPPFLAGS += -O3 -std=c++20
+
+LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)
+
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
 LOCAL_MODULE    := system_properties
 
-LOCAL_SRC_FILES := system_properties.cpp property_info.cpp
+LOCAL_SRC_FILES := system_properties.cpp prop_server.cpp prop_import.cpp prop_diff.cpp prop_summary.cpp prop_verify.cpp prop_cache.cpp prop_wait.cpp \
+                   prop_reader_bench.cpp prop_trace.cpp prop_ls.cpp prop_guard.cpp prop_info_build.cpp prop_clone.cpp
+
+LOCAL_STATIC_LIBRARIES := libsysprop
 
 LOCAL_CPPFLAGS += -O3 -std=c++20
 
@@ -26,4 +42,17 @@ LOCAL_LDLIBS +=-L$(SYSROOT)/usr/lib -llog
 
 include $(BUILD_EXECUTABLE)
 
+# offline checks against generated property_info images, run by tests/info_test.sh
+include $(CLEAR_VARS)
+
+LOCAL_MODULE    := property_info_test
+
+LOCAL_SRC_FILES := ../tests/property_info_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libsysprop
+
+LOCAL_CPPFLAGS += -O3 -std=c++20
+
+include $(BUILD_EXECUTABLE)
+
 
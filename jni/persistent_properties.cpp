@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "persistent_properties.h"
+
+#define WIRE_VARINT 0
+#define WIRE_FIXED64 1
+#define WIRE_LENGTH 2
+#define WIRE_FIXED32 5
+
+#define FIELD_PROPERTIES 1
+#define FIELD_NAME 1
+#define FIELD_VALUE 2
+
+static bool read_varint(const uint8_t *data, size_t size, size_t *pos, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *pos < size; shift += 7)
+    {
+        uint8_t byte = data[(*pos)++];
+        result |= (uint64_t) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// moves pos past a field whose tag has already been read
+static bool skip_field(const uint8_t *data, size_t size, size_t *pos, uint32_t wire_type)
+{
+    uint64_t len;
+    switch (wire_type)
+    {
+    case WIRE_VARINT:
+        return read_varint(data, size, pos, &len);
+    case WIRE_FIXED64:
+        len = 8;
+        break;
+    case WIRE_LENGTH:
+        if (!read_varint(data, size, pos, &len))
+        {
+            return false;
+        }
+        break;
+    case WIRE_FIXED32:
+        len = 4;
+        break;
+    default:
+        return false;
+    }
+    if (len > size - *pos)
+    {
+        return false;
+    }
+    *pos += len;
+    return true;
+}
+
+static void put_varint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char) value);
+}
+
+static size_t varint_size(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static void put_record(std::string &out, std::string_view name, std::string_view value)
+{
+    size_t record_len = 1 + varint_size(name.size()) + name.size() + 1 + varint_size(value.size()) + value.size();
+    out.push_back((char) (FIELD_PROPERTIES << 3 | WIRE_LENGTH));
+    put_varint(out, record_len);
+    out.push_back((char) (FIELD_NAME << 3 | WIRE_LENGTH));
+    put_varint(out, name.size());
+    out.append(name);
+    out.push_back((char) (FIELD_VALUE << 3 | WIRE_LENGTH));
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+PersistentPropertyFile::PersistentPropertyFile(const char *path)
+    : path_(path), data_(nullptr), size_(0), corrupt_(false)
+{
+}
+
+PersistentPropertyFile::~PersistentPropertyFile()
+{
+    if (data_ != nullptr)
+    {
+        munmap((void *) data_, size_);
+    }
+}
+
+prop_error PersistentPropertyFile::open()
+{
+    if (data_ != nullptr)
+    {
+        munmap((void *) data_, size_);
+        data_ = nullptr;
+    }
+    size_ = 0;
+    corrupt_ = false;
+    int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return errno == ENOENT ? PROP_OK : PROP_ERR_OPEN;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return PROP_ERR_OPEN;
+    }
+    if (st.st_size > 0)
+    {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            return PROP_ERR_MAP;
+        }
+        data_ = (const uint8_t *) addr;
+        size_ = st.st_size;
+    }
+    close(fd);
+    return PROP_OK;
+}
+
+PersistentPropertyFile::iterator &PersistentPropertyFile::iterator::operator++()
+{
+    const uint8_t *data = file_->data_;
+    size_t size = file_->size_;
+    while (pos_ < size)
+    {
+        size_t start = pos_;
+        uint64_t tag, len;
+        if (!read_varint(data, size, &pos_, &tag))
+        {
+            break;
+        }
+        if (tag != (FIELD_PROPERTIES << 3 | WIRE_LENGTH))
+        {
+            if (!skip_field(data, size, &pos_, tag & 7))
+            {
+                break;
+            }
+            continue;
+        }
+        if (!read_varint(data, size, &pos_, &len) || len > size - pos_)
+        {
+            break;
+        }
+        size_t end = pos_ + len;
+        current_ = persist_record();
+        bool ok = true;
+        while (ok && pos_ < end)
+        {
+            uint64_t field_tag, field_len;
+            ok = read_varint(data, end, &pos_, &field_tag);
+            if (ok && (field_tag == (FIELD_NAME << 3 | WIRE_LENGTH) || field_tag == (FIELD_VALUE << 3 | WIRE_LENGTH)))
+            {
+                ok = read_varint(data, end, &pos_, &field_len) && field_len <= end - pos_;
+                if (ok)
+                {
+                    std::string_view sv((const char *) data + pos_, field_len);
+                    (field_tag >> 3 == FIELD_NAME ? current_.name : current_.value) = sv;
+                    pos_ += field_len;
+                }
+            }
+            else if (ok)
+            {
+                ok = skip_field(data, end, &pos_, field_tag & 7);
+            }
+        }
+        if (!ok)
+        {
+            break;
+        }
+        current_.raw = std::string_view((const char *) data + start, end - start);
+        return *this;
+    }
+    if (pos_ < size)
+    {
+        file_->corrupt_ = true;
+    }
+    file_ = nullptr;
+    return *this;
+}
+
+prop_error PersistentPropertyFile::get(const char *prop_name, std::string *value)
+{
+    for (auto &record : *this)
+    {
+        if (record.name == prop_name)
+        {
+            *value = record.value;
+            return PROP_OK;
+        }
+    }
+    return corrupt_ ? PROP_ERR_CORRUPT : PROP_ERR_NOT_FOUND;
+}
+
+prop_error PersistentPropertyFile::set(const char *prop_name, const char *value)
+{
+    std::string content;
+    content.reserve(size_ + strlen(prop_name) + strlen(value) + 8);
+    bool found = false;
+    for (auto &record : *this)
+    {
+        if (record.name != prop_name)
+        {
+            content.append(record.raw);
+        }
+        else if (!found)
+        {
+            put_record(content, prop_name, value);
+            found = true;
+        }
+    }
+    if (corrupt_)
+    {
+        return PROP_ERR_CORRUPT;
+    }
+    if (!found)
+    {
+        put_record(content, prop_name, value);
+    }
+    return write_file(content);
+}
+
+prop_error PersistentPropertyFile::remove(const std::vector<std::string> &names, size_t *removed)
+{
+    std::vector<std::string_view> sorted(names.begin(), names.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::string content;
+    content.reserve(size_);
+    *removed = 0;
+    for (auto &record : *this)
+    {
+        if (std::binary_search(sorted.begin(), sorted.end(), record.name))
+        {
+            (*removed)++;
+        }
+        else
+        {
+            content.append(record.raw);
+        }
+    }
+    if (corrupt_)
+    {
+        return PROP_ERR_CORRUPT;
+    }
+    return *removed == 0 ? PROP_OK : write_file(content);
+}
+
+// same steps as init: write a temp file, fsync it, rename over the old one, fsync the directory
+prop_error PersistentPropertyFile::write_file(const std::string &content)
+{
+    std::string tmp_path = path_ + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        return PROP_ERR_OPEN;
+    }
+    const char *p = content.data();
+    size_t left = content.size();
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+    bool ok = left == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path_.c_str()) != 0)
+    {
+        unlink(tmp_path.c_str());
+        return PROP_ERR_OPEN;
+    }
+    std::string dir = path_;
+    int dir_fd = ::open(dirname(&dir[0]), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return open();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "property_store.h"
+
+#define PERSISTENT_PROPERTY_FILE "/data/property/persistent_properties"
+
+/**
+ * persist.* values saved by init, protobuf encoded without libprotobuf:
+ *
+ *   message PersistentProperties { repeated PersistentPropertyRecord properties = 1; }
+ *   message PersistentPropertyRecord { optional string name = 1; optional string value = 2; }
+ *
+ * The file is mmapped and decoded record by record; writes build the new
+ * file from the old one and replace it with a temp file + rename.
+ */
+
+struct persist_record
+{
+    std::string_view name;
+    std::string_view value;
+    // the whole "properties" field, copied as-is when the record is kept
+    std::string_view raw;
+};
+
+class PersistentPropertyFile
+{
+public:
+    explicit PersistentPropertyFile(const char *path = PERSISTENT_PROPERTY_FILE);
+    ~PersistentPropertyFile();
+    PersistentPropertyFile(const PersistentPropertyFile &) = delete;
+    PersistentPropertyFile &operator=(const PersistentPropertyFile &) = delete;
+
+    // a missing file reads as empty
+    prop_error open();
+    // false once an iteration stopped at a malformed record
+    bool is_corrupt() const { return corrupt_; }
+
+    class iterator
+    {
+    public:
+        iterator() : file_(nullptr), pos_(0) {}
+        iterator(PersistentPropertyFile *file) : file_(file), pos_(0) { ++(*this); }
+
+        const persist_record &operator*() const { return current_; }
+        const persist_record *operator->() const { return &current_; }
+        iterator &operator++();
+        bool operator==(const iterator &other) const { return file_ == other.file_; }
+        bool operator!=(const iterator &other) const { return file_ != other.file_; }
+
+    private:
+        PersistentPropertyFile *file_;
+        size_t pos_;
+        persist_record current_;
+    };
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+    prop_error get(const char *prop_name, std::string *value);
+    // adds or replaces the record
+    prop_error set(const char *prop_name, const char *value);
+    // drops every record named in names, removed counts the records that went away
+    prop_error remove(const std::vector<std::string> &names, size_t *removed);
+
+private:
+    prop_error write_file(const std::string &content);
+
+    std::string path_;
+    const uint8_t *data_;
+    size_t size_;
+    bool corrupt_;
+};
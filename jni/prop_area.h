@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PROP_NAME_MAX 32
+#define PROP_VALUE_MAX 92
+
+#define PROP_COUNT_MAX 0xFFFF // lower 2 bytes in serial
+
+#define AREA_SIZE (128 * 1024)
+#define AREA_DATA_SIZE (AREA_SIZE - (int)sizeof(prop_area))
+
+#define PROP_AREA_MAGIC 0x504f5250
+#define PROP_AREA_VERSION 0xfc6ed0ab
+// pre-4.4 list layout, still read by bionic's compat code up to Android N
+#define PROP_AREA_VERSION_COMPAT 0x45434f76
+
+#define ANDROID_N 24
+#define ANDROID_O 26
+
+#define ALIGN(x, alignment) ((x) + (sizeof(alignment) - 1) & ~(sizeof(alignment) - 1))
+
+#define PROPERTIES_FILE "/dev/__properties__"
+// under a split root, the area whose serial moves on every change
+#define PROP_SERIAL_AREA "properties_serial"
+
+/**
+ * Offsets linking prop_bt/prop_info are published by writers with a release
+ * store after the object behind them is filled in; readers take no lock and
+ * load them with acquire, the same order bionic uses.
+ */
+static inline uint32_t load_offset(const uint32_t *off)
+{
+    return __atomic_load_n(off, __ATOMIC_ACQUIRE);
+}
+
+static inline void publish_offset(uint32_t *off, uint32_t value)
+{
+    __atomic_store_n(off, value, __ATOMIC_RELEASE);
+}
+
+typedef struct prop_bt
+{
+    uint8_t namelen;
+    uint8_t reserved[3];
+    uint32_t prop;
+    uint32_t left;
+    uint32_t right;
+    uint32_t children;
+    char name[0];
+} prop_bt;
+
+/** 保存属性 key value */
+typedef struct prop_info
+{
+    uint32_t serial;
+    // uint8_t valuelen
+    // uint8_t kLongFlag
+    // uint16_t count
+    char value[PROP_VALUE_MAX];
+    char name[0];
+
+    // serial changes are single 32-bit stores, published after the value bytes
+    bool set_count(uint32_t count)
+    {
+        uint32_t old = get_serial();
+        if (count == PROP_COUNT_MAX || (old & PROP_COUNT_MAX) == count)
+            return false;
+        __atomic_store_n(&serial, (old & 0xFFFF0000) | (count & PROP_COUNT_MAX), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool set_value(const char *new_value)
+    {
+        if (new_value == NULL || strncmp(new_value, value, PROP_VALUE_MAX) == 0)
+            return false;
+
+        strncpy(value, new_value, sizeof(value));
+        __atomic_store_n(&serial, get_serial() & 0xFFFFFF | strlen(new_value) << 24, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // true when update_value_count() would write anything, checked without touching the page
+    bool needs_update(const char *prop_value, uint32_t prop_count)
+    {
+        return (prop_value != NULL && strncmp(prop_value, value, PROP_VALUE_MAX) != 0) ||
+               (prop_count != PROP_COUNT_MAX && get_count() != prop_count);
+    }
+
+    uint32_t get_serial() { return __atomic_load_n(&serial, __ATOMIC_ACQUIRE); }
+
+    uint32_t get_count() { return get_serial() & PROP_COUNT_MAX; }
+
+    bool is_long() { return serial & (1 << 16); }
+
+    bool update_value_count(const char *prop_value, uint32_t prop_count)
+    {
+        return set_value(prop_value) | set_count(prop_count);
+    }
+} prop_info;
+
+typedef struct prop_area
+{
+    uint32_t bytes_used;
+    uint32_t serial;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t reserved[28];
+    char data[0];
+} prop_area;
+
+// reserved[] word holding the data offset of the first free block, 0 for none (offset 0 is the root prop_bt)
+#define AREA_FREE_LIST 0
+
+/**
+ * A deleted prop_bt/prop_info range, chained from reserved[AREA_FREE_LIST].
+ * Only this tool knows about it; bionic never follows offsets into one.
+ */
+typedef struct prop_free
+{
+    uint32_t next;
+    uint32_t size;
+} prop_free;
+
+/**
+ * Pre-4.4 area: the same first four header words (bytes_used is the entry
+ * count), then a table of contents, one word per property with the name
+ * length in the top byte and the entry's offset from the area start below.
+ * Entries are fixed size; serial and value sit like in prop_info, with the
+ * name in front instead of behind.
+ */
+#define COMPAT_TOC_OFFSET 16
+#define COMPAT_TOC_NAME_LEN(toc) ((toc) >> 24)
+#define COMPAT_TOC_INFO(toc) ((toc) & 0xFFFFFF)
+
+typedef struct prop_info_compat
+{
+    char name[PROP_NAME_MAX];
+    uint32_t serial;
+    char value[PROP_VALUE_MAX];
+} prop_info_compat;
+
+static_assert(offsetof(prop_info_compat, value) - offsetof(prop_info_compat, serial) == offsetof(prop_info, value),
+              "compat serial/value must line up with prop_info");
+
+enum prop_area_format
+{
+    AREA_FORMAT_UNKNOWN,
+    AREA_FORMAT_TRIE,   // Android 4.4 and later, one per context from N
+    AREA_FORMAT_COMPAT, // before 4.4, read-only here
+};
+
+// from the header alone, so images of any release can be read offline
+static inline prop_area_format get_area_format(const prop_area *header, size_t file_size)
+{
+    if (file_size < sizeof(prop_area) || header->magic != PROP_AREA_MAGIC)
+        return AREA_FORMAT_UNKNOWN;
+    if (header->version == PROP_AREA_VERSION && file_size == AREA_SIZE)
+        return AREA_FORMAT_TRIE;
+    if (header->version == PROP_AREA_VERSION_COMPAT && file_size <= AREA_SIZE)
+        return AREA_FORMAT_COMPAT;
+    return AREA_FORMAT_UNKNOWN;
+}
@@ -0,0 +1,36 @@
+#include <stdlib.h>
+
+#include "prop_arena.h"
+#include "prop_stats.h"
+
+PropArena::~PropArena()
+{
+    while (head_ != nullptr)
+    {
+        chunk *next = head_->next;
+        free(head_);
+        head_ = next;
+    }
+}
+
+void *PropArena::grow(size_t min_size)
+{
+    size_t size = next_size_;
+    while (size < min_size + sizeof(chunk))
+    {
+        size *= 2;
+    }
+    chunk *c = (chunk *) malloc(size);
+    if (c == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    PROP_STATS_ADD(COUNTER_ALLOCATIONS, 1);
+    c->next = head_;
+    c->size = size;
+    head_ = c;
+    pos_ = (char *) (c + 1);
+    end_ = (char *) c + size;
+    next_size_ = size * 2;
+    return pos_;
+}
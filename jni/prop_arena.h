@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <new>
+#include <string_view>
+
+/**
+ * Bump allocator for storage that lives as long as one run (or one store):
+ * context lists, property_info trie nodes, dump entries. Memory comes in
+ * chunks that double in size and is only given back when the arena goes
+ * away, so nothing allocated here is ever freed on its own.
+ */
+class PropArena
+{
+public:
+    explicit PropArena(size_t first_chunk = 16 * 1024) : head_(nullptr), pos_(nullptr), end_(nullptr),
+                                                         next_size_(first_chunk), used_(0) {}
+    ~PropArena();
+    PropArena(const PropArena &) = delete;
+    PropArena &operator=(const PropArena &) = delete;
+
+    void *alloc(size_t size, size_t align = alignof(max_align_t))
+    {
+        uintptr_t p = ((uintptr_t) pos_ + align - 1) & ~(uintptr_t) (align - 1);
+        if (pos_ == nullptr || p + size > (uintptr_t) end_)
+        {
+            p = (uintptr_t) grow(size + align);
+            p = (p + align - 1) & ~(uintptr_t) (align - 1);
+        }
+        pos_ = (char *) (p + size);
+        used_ += size;
+        return (void *) p;
+    }
+
+    // value-initialized array, T's destructor never runs
+    template <typename T>
+    T *make_array(size_t count)
+    {
+        T *p = (T *) alloc(sizeof(T) * count, alignof(T));
+        for (size_t i = 0; i < count; i++)
+        {
+            new (p + i) T();
+        }
+        return p;
+    }
+
+    // NUL terminated copy
+    std::string_view copy(std::string_view sv)
+    {
+        char *p = (char *) alloc(sv.size() + 1, 1);
+        memcpy(p, sv.data(), sv.size());
+        p[sv.size()] = '\0';
+        return std::string_view(p, sv.size());
+    }
+
+    // bytes handed out so far
+    size_t used() const { return used_; }
+
+private:
+    struct chunk
+    {
+        chunk *next;
+        size_t size;
+    };
+
+    void *grow(size_t min_size);
+
+    chunk *head_;
+    char *pos_;
+    char *end_;
+    size_t next_size_;
+    size_t used_;
+};
+
+/** std allocator on top of a PropArena; deallocate() is a no-op. */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(PropArena *arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(size_t n) { return (T *) arena_->alloc(n * sizeof(T), alignof(T)); }
+    void deallocate(T *, size_t) {}
+
+    PropArena *arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena(); }
+
+private:
+    PropArena *arena_;
+};
@@ -0,0 +1,171 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "prop_audit.h"
+
+// NULL reads as empty, longer strings are cut to size - 1 bytes
+static void copy_field(char *dst, size_t size, const char *src)
+{
+    size_t len = src == NULL ? 0 : strnlen(src, size - 1);
+    if (len > 0)
+    {
+        memcpy(dst, src, len);
+    }
+    dst[len] = '\0';
+}
+
+const char *prop_audit_op_name(uint8_t op)
+{
+    switch (op)
+    {
+    case AUDIT_SET:
+        return "set";
+    case AUDIT_COUNT:
+        return "count";
+    case AUDIT_RESTORE:
+        return "restore";
+    case AUDIT_CREATE:
+        return "create";
+    case AUDIT_DELETE:
+        return "delete";
+    default:
+        return "?";
+    }
+}
+
+PropAuditLog::PropAuditLog(const char *path)
+    : path_(path), header_(nullptr), entries_(nullptr), size_(0), slots_(0), pid_(getpid())
+{
+}
+
+PropAuditLog::~PropAuditLog()
+{
+    if (header_ != nullptr)
+    {
+        munmap(header_, size_);
+    }
+}
+
+prop_error PropAuditLog::open(bool writable)
+{
+    if (header_ != nullptr)
+    {
+        return PROP_OK;
+    }
+    int fd = ::open(path_.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        return PROP_ERR_OPEN;
+    }
+    // the first two writers would both lay out the header, readers must not see it half done
+    while (flock(fd, writable ? LOCK_EX : LOCK_SH) < 0 && errno == EINTR)
+    {
+    }
+    prop_error err = PROP_OK;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        err = PROP_ERR_OPEN;
+    }
+    else if (st.st_size == 0 && writable)
+    {
+        prop_audit_header header = {PROP_AUDIT_MAGIC, sizeof(prop_audit_entry), PROP_AUDIT_SLOTS, 0, 0};
+        st.st_size = sizeof(prop_audit_header) + PROP_AUDIT_SLOTS * sizeof(prop_audit_entry);
+        if (ftruncate(fd, st.st_size) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header))
+        {
+            err = PROP_ERR_OPEN;
+        }
+    }
+    void *addr = MAP_FAILED;
+    if (err == PROP_OK && (size_t) st.st_size < sizeof(prop_audit_header))
+    {
+        err = PROP_ERR_BAD_AREA;
+    }
+    else if (err == PROP_OK)
+    {
+        addr = mmap(NULL, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        err = addr == MAP_FAILED ? PROP_ERR_MAP : PROP_OK;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (err != PROP_OK)
+    {
+        return err;
+    }
+
+    prop_audit_header *header = (prop_audit_header *) addr;
+    if (header->magic != PROP_AUDIT_MAGIC || header->entry_size != sizeof(prop_audit_entry) || header->slots == 0 ||
+        header->slots > (st.st_size - sizeof(prop_audit_header)) / sizeof(prop_audit_entry))
+    {
+        munmap(addr, st.st_size);
+        return PROP_ERR_BAD_VERSION;
+    }
+    header_ = header;
+    entries_ = (prop_audit_entry *) (header + 1);
+    size_ = st.st_size;
+    slots_ = header->slots;
+    return PROP_OK;
+}
+
+void PropAuditLog::record(prop_audit_op op, const char *name, const char *old_value, uint32_t old_serial,
+                          const char *new_value, uint32_t new_serial)
+{
+    if (header_ == nullptr)
+    {
+        return;
+    }
+    uint64_t ticket = __atomic_fetch_add(&header_->next, 1, __ATOMIC_RELAXED);
+    prop_audit_entry *entry = &entries_[ticket % slots_];
+    // seq 0 first: a reader racing with us, or finding the slot after we died, drops it
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    entry->time_ns = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    entry->pid = pid_;
+    entry->old_serial = old_serial;
+    entry->new_serial = new_serial;
+    entry->op = op;
+    copy_field(entry->name, sizeof(entry->name), name);
+    copy_field(entry->old_value, sizeof(entry->old_value), old_value);
+    copy_field(entry->new_value, sizeof(entry->new_value), new_value);
+    __atomic_store_n(&entry->seq, ticket + 1, __ATOMIC_RELEASE);
+}
+
+void PropAuditLog::read(std::vector<prop_audit_entry> *out, size_t *torn) const
+{
+    *torn = 0;
+    if (header_ == nullptr)
+    {
+        return;
+    }
+    // the slots are already in ticket order starting at next - slots, no sort needed
+    uint64_t next = __atomic_load_n(&header_->next, __ATOMIC_ACQUIRE);
+    uint64_t first = next > slots_ ? next - slots_ : 0;
+    out->reserve(out->size() + (next - first));
+    for (uint64_t ticket = first; ticket < next; ticket++)
+    {
+        const prop_audit_entry *entry = &entries_[ticket % slots_];
+        uint64_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        prop_audit_entry copy;
+        memcpy(&copy, entry, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != ticket + 1 || __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq)
+        {
+            (*torn)++;
+            continue;
+        }
+        copy.seq = seq;
+        copy.name[sizeof(copy.name) - 1] = '\0';
+        copy.old_value[sizeof(copy.old_value) - 1] = '\0';
+        copy.new_value[sizeof(copy.new_value) - 1] = '\0';
+        out->push_back(copy);
+    }
+}
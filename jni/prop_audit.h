@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "property_store.h"
+
+#define PROP_AUDIT_FILE "/data/local/tmp/system_properties.audit"
+#define PROP_AUDIT_MAGIC 0x31415053 // "SPA1"
+#define PROP_AUDIT_SLOTS 4096
+// longer names are cut, the entry keeps their first bytes
+#define PROP_AUDIT_NAME_MAX 96
+
+/**
+ * Fixed-size ring of every write made through a PropertyStore, shared by all
+ * processes that write with the same file:
+ *
+ *   prop_audit_header | prop_audit_entry[slots]
+ *
+ * A writer takes a ticket with one atomic add on header.next and owns slot
+ * ticket % slots. The slot's seq is cleared, the fields are written and seq
+ * is stored as ticket + 1 last, so a reader copies the slot and keeps it
+ * only if seq was the same before and after and belongs to that ticket.
+ * Nothing is locked and nothing is synced to disk: a record costs a clock
+ * read and a ~300 byte copy into the page cache.
+ */
+
+enum prop_audit_op
+{
+    AUDIT_SET = 1,      // value and/or count changed by update()
+    AUDIT_COUNT,        // counter only, set_counts()
+    AUDIT_RESTORE,      // serial/value put back from a journal
+    AUDIT_CREATE,
+    AUDIT_DELETE,
+};
+
+struct prop_audit_header
+{
+    uint32_t magic;
+    uint32_t entry_size;    // sizeof(prop_audit_entry) of the writer that created the file
+    uint32_t slots;
+    uint32_t reserved;
+    uint64_t next;          // tickets handed out so far
+};
+
+struct prop_audit_entry
+{
+    uint64_t seq;           // ticket + 1 once complete, 0 while being written
+    uint64_t time_ns;       // CLOCK_REALTIME
+    uint32_t pid;
+    uint32_t old_serial;
+    uint32_t new_serial;
+    uint8_t op;
+    uint8_t pad[3];
+    char name[PROP_AUDIT_NAME_MAX];
+    char old_value[PROP_VALUE_MAX];
+    char new_value[PROP_VALUE_MAX];
+};
+
+static_assert(sizeof(prop_audit_entry) % 8 == 0, "entries must keep seq aligned");
+
+class PropAuditLog
+{
+public:
+    explicit PropAuditLog(const char *path = PROP_AUDIT_FILE);
+    ~PropAuditLog();
+    PropAuditLog(const PropAuditLog &) = delete;
+    PropAuditLog &operator=(const PropAuditLog &) = delete;
+
+    // writable creates the file with PROP_AUDIT_SLOTS slots when missing
+    prop_error open(bool writable);
+    bool is_open() const { return header_ != nullptr; }
+    const std::string &path() const { return path_; }
+
+    // values may be NULL (nothing before a create, nothing after a delete)
+    void record(prop_audit_op op, const char *name, const char *old_value, uint32_t old_serial,
+                const char *new_value, uint32_t new_serial);
+    /**
+     * Complete entries still in the ring, oldest first. torn counts the
+     * slots skipped because a writer was inside them, died there or
+     * lapped them while reading.
+     */
+    void read(std::vector<prop_audit_entry> *out, size_t *torn) const;
+
+private:
+    std::string path_;
+    prop_audit_header *header_;
+    prop_audit_entry *entries_;
+    size_t size_;
+    // from the header when mapped, the file can't resize the ring under us
+    uint32_t slots_;
+    uint32_t pid_;
+};
+
+const char *prop_audit_op_name(uint8_t op);
@@ -0,0 +1,134 @@
+#include <string.h>
+
+#include "prop_bionic.h"
+
+// to_prop_obj(): bionic only checks the offset against the data size
+static const void *to_prop_obj(const prop_area *area, uint32_t off)
+{
+    if (off > AREA_DATA_SIZE)
+    {
+        return NULL;
+    }
+    return area->data + off;
+}
+
+static int cmp_prop_name(const char *one, uint32_t one_len, const char *two, uint32_t two_len)
+{
+    if (one_len < two_len)
+    {
+        return -1;
+    }
+    else if (one_len > two_len)
+    {
+        return 1;
+    }
+    return strncmp(one, two, one_len);
+}
+
+// find_prop_bt() without alloc_if_needed; sibling links are loaded relaxed as in bionic
+static const prop_bt *find_prop_bt(const prop_area *area, const prop_bt *bt, const char *name, uint32_t namelen,
+                                   uint32_t *nodes)
+{
+    const prop_bt *current = bt;
+    while (current != NULL)
+    {
+        (*nodes)++;
+        int ret = cmp_prop_name(name, namelen, current->name, current->namelen);
+        if (ret == 0)
+        {
+            return current;
+        }
+        uint32_t off = __atomic_load_n(ret < 0 ? &current->left : &current->right, __ATOMIC_RELAXED);
+        if (off == 0)
+        {
+            return NULL;
+        }
+        current = (const prop_bt *) to_prop_obj(area, off);
+    }
+    return NULL;
+}
+
+const prop_info *bionic_find(const prop_area *area, const char *name, uint32_t *nodes)
+{
+    *nodes = 0;
+    const prop_bt *current = (const prop_bt *) to_prop_obj(area, 0);
+    const char *remaining_name = name;
+    for (;;)
+    {
+        const char *sep = strchr(remaining_name, '.');
+        bool want_subtree = sep != NULL;
+        uint32_t substr_size = want_subtree ? sep - remaining_name : strlen(remaining_name);
+        if (substr_size == 0)
+        {
+            return NULL;
+        }
+        uint32_t children = __atomic_load_n(&current->children, __ATOMIC_RELAXED);
+        const prop_bt *root = children != 0 ? (const prop_bt *) to_prop_obj(area, children) : NULL;
+        if (root == NULL)
+        {
+            return NULL;
+        }
+        current = find_prop_bt(area, root, remaining_name, substr_size, nodes);
+        if (current == NULL)
+        {
+            return NULL;
+        }
+        if (!want_subtree)
+        {
+            break;
+        }
+        remaining_name = sep + 1;
+    }
+    uint32_t prop = __atomic_load_n(&current->prop, __ATOMIC_RELAXED);
+    return prop != 0 ? (const prop_info *) to_prop_obj(area, prop) : NULL;
+}
+
+// prop_info::long_value(), NULL when the offset leaves the area
+static const char *long_value(const prop_area *area, const prop_info *pi)
+{
+    uint32_t off;
+    memcpy(&off, pi->value + BIONIC_LONG_OFFSET_POS, sizeof(off));
+    size_t left = (const char *) area + AREA_SIZE - (const char *) pi;
+    return off < left ? (const char *) pi + off : NULL;
+}
+
+bool bionic_read_callback(const prop_area *area, const prop_info *pi, bionic_read_fn callback, void *cookie,
+                          bool *from_backup)
+{
+    *from_backup = false;
+    // read-only values never change after init set them, so neither copy nor retry
+    if (strncmp(pi->name, "ro.", 3) == 0)
+    {
+        uint32_t serial = __atomic_load_n(&pi->serial, __ATOMIC_RELAXED);
+        const char *value = (serial & BIONIC_LONG_FLAG) != 0 ? long_value(area, pi) : pi->value;
+        if (value == NULL)
+        {
+            return false;
+        }
+        callback(cookie, pi->name, value, serial);
+        return true;
+    }
+    // ReadMutablePropertyValue()
+    char value[PROP_VALUE_MAX];
+    const char *backup = area->data + sizeof(prop_bt);
+    uint32_t serial;
+    for (;;)
+    {
+        serial = __atomic_load_n(&pi->serial, __ATOMIC_ACQUIRE);
+        size_t len = BIONIC_SERIAL_VALUE_LEN(serial);
+        if (len >= PROP_VALUE_MAX)
+        {
+            len = PROP_VALUE_MAX - 1;
+        }
+        *from_backup = BIONIC_SERIAL_DIRTY(serial);
+        memcpy(value, *from_backup ? backup : pi->value, len + 1);
+        value[len] = '\0';
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (serial == __atomic_load_n(&pi->serial, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+    callback(cookie, pi->name, value, serial);
+    return true;
+}
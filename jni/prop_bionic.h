@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "prop_area.h"
+
+/**
+ * Host-side copy of bionic's reader path (libc/system_properties/prop_area.cpp
+ * and system_properties.cpp), to measure what every other process pays for
+ * __system_property_find() and __system_property_read_callback() on a trie
+ * area this tool wrote. Same walk, same loads, same bounds check; only the
+ * context lookup in front of it is left out.
+ */
+
+// bit 0 of prop_info::serial: a write is in progress and the old value sits in the backup area
+#define BIONIC_SERIAL_DIRTY(serial) ((serial) & 1)
+#define BIONIC_SERIAL_VALUE_LEN(serial) ((serial) >> 24)
+// kLongFlag set: value[] holds an error message, then the long value's offset from the prop_info
+#define BIONIC_LONG_FLAG (1 << 16)
+#define BIONIC_LONG_OFFSET_POS 56
+
+typedef void (*bionic_read_fn)(void *cookie, const char *name, const char *value, uint32_t serial);
+
+// prop_area::find(): NULL when name isn't there; nodes counts the prop_bt compared on the way
+const prop_info *bionic_find(const prop_area *area, const char *name, uint32_t *nodes);
+
+/**
+ * SystemProperties::ReadCallback(): ro.* values are passed in place, others
+ * are copied and re-read until the serial is stable. A dirty serial makes
+ * bionic copy from the backup area behind the root node instead of value[];
+ * this tool keeps its counter in the low serial bits, so an odd count does
+ * that too, and from_backup reports it. false for a long value pointing out
+ * of the area.
+ */
+bool bionic_read_callback(const prop_area *area, const prop_info *pi, bionic_read_fn callback, void *cookie,
+                          bool *from_backup);
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "prop_cache.h"
+
+#define AREA_HEADER_WORDS 5
+#define RECORD_HEADER_SIZE 8
+
+static uint32_t get_u32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t get_u64(const char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint16_t get_u16(const char *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void put_u32(std::string &out, uint32_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+static void put_u64(std::string &out, uint64_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+static void put_u16(std::string &out, uint16_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+DumpCache::DumpCache(const char *path) : path_(path), data_(NULL), size_(0), hits_(0), misses_(0)
+{
+}
+
+DumpCache::~DumpCache()
+{
+    if (data_ != NULL)
+        munmap((void *)data_, size_);
+}
+
+void DumpCache::load(PropertyStore &store)
+{
+    const std::string &root = store.root();
+    put_u32(out_, DUMP_CACHE_MAGIC);
+    put_u32(out_, root.size());
+    out_.append(root);
+
+    int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            data_ = (const char *)addr;
+            size_ = st.st_size;
+        }
+    }
+    close(fd);
+    if (data_ == NULL || size_ < 8 || get_u32(data_) != DUMP_CACHE_MAGIC)
+        return;
+    size_t root_len = get_u32(data_ + 4);
+    if (root_len > size_ - 8 || std::string_view(data_ + 8, root_len) != root)
+        return;
+
+    size_t pos = 8 + root_len;
+    while (size_ - pos >= AREA_HEADER_WORDS * sizeof(uint32_t))
+    {
+        const char *p = data_ + pos;
+        size_t context_len = get_u32(p);
+        size_t records_len = get_u32(p + 8);
+        size_t header_len = AREA_HEADER_WORDS * sizeof(uint32_t);
+        if (context_len > size_ - pos - header_len || records_len > size_ - pos - header_len - context_len)
+            break;
+        cached_area area;
+        area.props = get_u32(p + 4);
+        area.hash = get_u64(p + 12);
+        area.block = std::string_view(p, header_len + context_len + records_len);
+        area.records = std::string_view(p + header_len + context_len, records_len);
+        areas_[std::string_view(p + header_len, context_len)] = area;
+        pos += area.block.size();
+    }
+}
+
+bool DumpCache::splice(AreaHandle &area, uint64_t hash, std::vector<prop_content, ArenaAllocator<prop_content>> &out)
+{
+    auto it = areas_.find(area.context());
+    if (it == areas_.end() || it->second.hash != hash)
+        return false;
+    const cached_area &cached = it->second;
+    size_t first = out.size();
+    const char *p = cached.records.data();
+    const char *end = p + cached.records.size();
+    for (uint32_t i = 0; i < cached.props; i++)
+    {
+        if (end - p < RECORD_HEADER_SIZE)
+            break;
+        size_t name_len = get_u16(p + 4);
+        size_t value_len = get_u16(p + 6);
+        if ((size_t)(end - p) - RECORD_HEADER_SIZE < name_len + value_len)
+            break;
+        prop_content content;
+        content.serial = get_u32(p);
+        content.name = std::string_view(p + RECORD_HEADER_SIZE, name_len);
+        content.value = std::string_view(p + RECORD_HEADER_SIZE + name_len, value_len);
+        out.push_back(content);
+        p += RECORD_HEADER_SIZE + name_len + value_len;
+    }
+    if (p != end || out.size() - first != cached.props)
+    {
+        out.resize(first);
+        return false;
+    }
+    out_.append(cached.block);
+    hits_++;
+    return true;
+}
+
+void DumpCache::update(AreaHandle &area, uint64_t hash, const prop_content *props, size_t count)
+{
+    misses_++;
+    size_t records_len = 0;
+    for (size_t i = 0; i < count; i++)
+        records_len += RECORD_HEADER_SIZE + props[i].name.size() + props[i].value.size();
+    put_u32(out_, area.context().size());
+    put_u32(out_, count);
+    put_u32(out_, records_len);
+    put_u64(out_, hash);
+    out_.append(area.context());
+    for (size_t i = 0; i < count; i++)
+    {
+        put_u32(out_, props[i].serial);
+        put_u16(out_, props[i].name.size());
+        put_u16(out_, props[i].value.size());
+        out_.append(props[i].name);
+        out_.append(props[i].value);
+    }
+}
+
+bool DumpCache::save()
+{
+    // unchanged areas were copied verbatim, so an all-hit run leaves the file alone
+    if (misses_ == 0 && hits_ == areas_.size())
+        return true;
+    std::string tmp_path = path_ + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool ok = fwrite(out_.data(), 1, out_.size(), file) == out_.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path_.c_str()) != 0)
+    {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
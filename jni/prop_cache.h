@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "system_properties.h"
+
+/**
+ * --cache FILE: the decoded contents of every area from the last dump. Each
+ * area is kept only while its content_hash() is the one it was walked at.
+ * No serial is part of the key: init moves properties_serial on every change
+ * anywhere and no per-area serial at all, and this tool's own writes move
+ * none. A later dump walks the areas that missed and splices the cached
+ * entries in for the rest, so a steady-state dump costs one hash pass over
+ * the used bytes of each area plus a walk of the areas that changed.
+ *
+ * The file is mmapped for the whole run and the spliced entries point
+ * into it. Native byte order:
+ *   u32 magic | u32 root_len | root
+ *   { u32 context_len | u32 props | u32 records_len | u64 hash | context
+ *     | { u32 serial | u16 name_len | u16 value_len | name | value }* }*
+ * A missing, foreign or damaged file just makes every area a miss.
+ */
+
+#define DUMP_CACHE_MAGIC 0x33435053 // "SPC3"
+
+class DumpCache
+{
+public:
+    explicit DumpCache(const char *path);
+    ~DumpCache();
+    DumpCache(const DumpCache &) = delete;
+    DumpCache &operator=(const DumpCache &) = delete;
+
+    // maps the old file; entries for another root are ignored
+    void load(PropertyStore &store);
+    // appends the cached entries of area to out when they were walked at content hash
+    bool splice(AreaHandle &area, uint64_t hash, std::vector<prop_content, ArenaAllocator<prop_content>> &out);
+    // records a fresh walk of area, hash taken before walking
+    void update(AreaHandle &area, uint64_t hash, const prop_content *props, size_t count);
+    // rewrites the file when any area missed
+    bool save();
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    struct cached_area
+    {
+        uint64_t hash;
+        uint32_t props;
+        std::string_view block; // header, context and records, copied as-is on a hit
+        std::string_view records;
+    };
+
+    std::string path_;
+    const char *data_;
+    size_t size_;
+    std::unordered_map<std::string_view, cached_area> areas_;
+    std::string out_;
+    size_t hits_;
+    size_t misses_;
+};
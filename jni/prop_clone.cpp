@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_clone.h"
+
+struct clone_entry
+{
+    std::string name;
+    bool is_area;
+    uint32_t serial;
+    uint32_t bytes_used;
+    uint64_t hash;
+};
+
+static uint64_t clock_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t fnv1a64(const uint8_t *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// every byte but the serial word, which only init moves and a commit leaves alone
+static uint64_t area_hash(const uint8_t *data, size_t size)
+{
+    const size_t serial_end = offsetof(prop_area, serial) + sizeof(uint32_t);
+    if (size < serial_end)
+        return fnv1a64(data, size);
+    return fnv1a64(data + serial_end, size - serial_end, fnv1a64(data, offsetof(prop_area, serial)));
+}
+
+// read-only private mapping of a whole file, NULL on failure (an empty file too)
+static const uint8_t *map_file(const std::string &path, size_t *size)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return NULL;
+    *size = st.st_size;
+    return (const uint8_t *)addr;
+}
+
+static bool hash_file(const std::string &path, bool is_area, uint64_t *hash)
+{
+    size_t size;
+    const uint8_t *data = map_file(path, &size);
+    if (data == NULL)
+        return false;
+    *hash = is_area ? area_hash(data, size) : fnv1a64(data, size);
+    munmap((void *)data, size);
+    return true;
+}
+
+static bool write_all(int fd, const char *p, size_t left)
+{
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+/**
+ * copy_file_range on one filesystem, sendfile from the tmpfs of the live
+ * areas to a disk, read/write when neither is there. A method is only given
+ * up before it moved any byte, both fds still at offset 0.
+ */
+static bool copy_file(const std::string &from, const std::string &to)
+{
+    int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+    struct stat st;
+    if (fstat(in, &st) != 0)
+    {
+        close(in);
+        return false;
+    }
+    int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, (st.st_mode & 0777) | S_IWUSR);
+    if (out < 0)
+    {
+        close(in);
+        return false;
+    }
+#ifdef __NR_copy_file_range
+    int method = 0;
+#else
+    int method = 1;
+#endif
+    off_t left = st.st_size;
+    while (left > 0)
+    {
+        ssize_t n = -1;
+        if (method == 0)
+        {
+#ifdef __NR_copy_file_range
+            n = syscall(__NR_copy_file_range, in, NULL, out, NULL, (size_t)left, 0);
+#endif
+        }
+        else if (method == 1)
+            n = sendfile(out, in, NULL, left);
+        else
+        {
+            char buf[65536];
+            n = read(in, buf, std::min((off_t)sizeof(buf), left));
+            if (n > 0 && !write_all(out, buf, n))
+                n = -1;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && method < 2 && left == st.st_size &&
+            (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+        {
+            method++;
+            continue;
+        }
+        if (n <= 0)
+            break;
+        left -= n;
+    }
+    int saved_errno = errno;
+    close(in);
+    if (close(out) != 0)
+        return false;
+    errno = saved_errno;
+    return left == 0;
+}
+
+// manifests name the root by its real path, so --root may be spelled differently at commit
+static std::string real_root(const std::string &root)
+{
+    char *path = realpath(root.c_str(), NULL);
+    std::string result = path != NULL ? path : root;
+    free(path);
+    return result;
+}
+
+// hashed from the live mapping: init moves no per-area serial, so only the bytes tell a change
+static bool area_moved(AreaHandle &area, const clone_entry &entry)
+{
+    return area_hash((const uint8_t *)area.area(), area.size()) != entry.hash;
+}
+
+// the manifest is replaced whole, a commit rewrites it for the areas it wrote
+static bool write_manifest(const std::string &path, const std::string &root, const std::vector<clone_entry> &entries)
+{
+    std::string content = "root " + root + "\n";
+    char line[512];
+    for (const clone_entry &entry : entries)
+    {
+        if (entry.is_area)
+            snprintf(line, sizeof(line), "area %s 0x%08x %u %016llx\n", entry.name.c_str(), entry.serial,
+                     entry.bytes_used, (unsigned long long)entry.hash);
+        else
+            snprintf(line, sizeof(line), "file %s %016llx\n", entry.name.c_str(), (unsigned long long)entry.hash);
+        content += line;
+    }
+    std::string tmp_path = path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "w");
+    bool ok = file != NULL && fwrite(content.data(), 1, content.size(), file) == content.size();
+    if (file == NULL || fclose(file) != 0 || !ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        fprintf(stderr, "can't write [%s]: %s\n", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+int run_clone(PropertyStore &store, const char *dest)
+{
+    if (!store.is_split())
+    {
+        fprintf(stderr, "--clone needs a root directory of per-context areas\n");
+        return -1;
+    }
+    if (mkdir(dest, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "can't create [%s]: %s\n", dest, strerror(errno));
+        return -1;
+    }
+    uint64_t start = clock_ns();
+    std::vector<AreaHandle *> areas;
+    for (size_t i = 0; i < store.area_count(); i++)
+        areas.push_back(&store.area_at(i));
+    if (store.serial_area() != NULL)
+        areas.push_back(store.serial_area());
+
+    std::vector<clone_entry> entries;
+    size_t bytes = 0;
+    for (AreaHandle *area : areas)
+    {
+        prop_error err = area->map(false);
+        if (err == PROP_ERR_OPEN && area->last_errno() == ENOENT)
+            continue;
+        if (err != PROP_OK)
+        {
+            report_error(err, area);
+            return -1;
+        }
+        std::string to = std::string(dest) + "/" + area->context();
+        clone_entry entry = {area->context(), true, 0, 0, 0};
+        int attempt;
+        for (attempt = 0; attempt < CLONE_RETRIES; attempt++)
+        {
+            entry.serial = load_offset(&area->area()->serial);
+            entry.bytes_used = load_offset(&area->area()->bytes_used);
+            if (!copy_file(area->path(), to))
+            {
+                fprintf(stderr, "copy [%s] to [%s]: %s\n", area->path().c_str(), to.c_str(), strerror(errno));
+                return -1;
+            }
+            if (!hash_file(to, true, &entry.hash))
+            {
+                fprintf(stderr, "can't read back [%s]: %s\n", to.c_str(), strerror(errno));
+                return -1;
+            }
+            // a copy torn by a write during it doesn't hash like the live area
+            if (!area_moved(*area, entry))
+                break;
+        }
+        if (attempt == CLONE_RETRIES)
+        {
+            fprintf(stderr, "[%s] kept changing while copied, giving up\n", area->context().c_str());
+            return -1;
+        }
+        entries.push_back(entry);
+        if (g_verbose_mode)
+            print_log("[%s]: serial 0x%08x, %u bytes used%s\n", entry.name.c_str(), entry.serial, entry.bytes_used,
+                      attempt > 0 ? ", copied again" : "");
+        bytes += area->size();
+    }
+
+    std::string info_path = store.root() + "/property_info";
+    if (access(info_path.c_str(), F_OK) == 0)
+    {
+        std::string to = std::string(dest) + "/property_info";
+        clone_entry entry = {"property_info", false, 0, 0, 0};
+        if (!copy_file(info_path, to) || !hash_file(to, false, &entry.hash))
+        {
+            fprintf(stderr, "copy [%s] to [%s]: %s\n", info_path.c_str(), to.c_str(), strerror(errno));
+            return -1;
+        }
+        entries.push_back(entry);
+    }
+
+    if (!write_manifest(std::string(dest) + "/" PROP_CLONE_MANIFEST, real_root(store.root()), entries))
+        return -1;
+    print_log("cloned %zu files (%zu area bytes) into [%s] in %.1f ms\n", entries.size(), bytes, dest,
+              (clock_ns() - start) / 1e6);
+    return 0;
+}
+
+static bool read_manifest(const std::string &path, std::string *root, std::vector<clone_entry> *entries)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL)
+        return false;
+    char line[512], name[256];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        clone_entry entry = {"", true, 0, 0, 0};
+        unsigned long long hash;
+        if (strncmp(line, "root ", 5) == 0)
+        {
+            root->assign(line + 5, strcspn(line + 5, "\n"));
+            continue;
+        }
+        if (sscanf(line, "area %255s %x %u %llx", name, &entry.serial, &entry.bytes_used, &hash) == 4)
+            entry.is_area = true;
+        else if (sscanf(line, "file %255s %llx", name, &hash) == 2)
+            entry.is_area = false;
+        else
+            ok = false;
+        entry.name = name;
+        entry.hash = hash;
+        entries->push_back(entry);
+    }
+    fclose(file);
+    return ok && !root->empty();
+}
+
+// differing pages only, last to first so the header page with bytes_used lands after the data it covers
+static size_t copy_pages(uint8_t *live, const uint8_t *from, size_t size)
+{
+    const size_t page = getpagesize();
+    // the live serial stays, only init moves it
+    const size_t serial_off = offsetof(prop_area, serial);
+    size_t written = 0;
+    for (size_t off = (size - 1) / page * page;; off -= page)
+    {
+        size_t len = std::min(page, size - off);
+        if (memcmp(live + off, from + off, len) != 0)
+        {
+            if (off <= serial_off && serial_off < off + len)
+            {
+                memcpy(live + off, from + off, serial_off - off);
+                size_t rest = serial_off + sizeof(uint32_t);
+                memcpy(live + rest, from + rest, off + len - rest);
+            }
+            else
+                memcpy(live + off, from + off, len);
+            written++;
+        }
+        if (off == 0)
+            break;
+    }
+    return written;
+}
+
+struct commit_area
+{
+    AreaHandle *area;
+    clone_entry *entry;
+    std::string path;
+    uint64_t hash;
+};
+
+// 0 when written, 1 when the live area moved after all, -1 on errors
+static int commit_area_pages(commit_area &c)
+{
+    AreaHandle *area = c.area;
+    prop_error err = area->map(true);
+    if (err != PROP_OK)
+    {
+        report_error(err, area);
+        return -1;
+    }
+    AreaWriteLock lock(area);
+    if (lock.error() != PROP_OK)
+    {
+        report_error(lock.error(), area);
+        return -1;
+    }
+    // writers of this tool are held off by the lock now, init is not: the live bytes are hashed again
+    if (area_moved(*area, *c.entry))
+    {
+        fprintf(stderr, "[%s] changed while committing\n", area->context().c_str());
+        return 1;
+    }
+    size_t size;
+    const uint8_t *from = map_file(c.path, &size);
+    if (from == NULL || size != area->size())
+    {
+        fprintf(stderr, "can't read [%s]: %s\n", c.path.c_str(), strerror(errno));
+        if (from != NULL)
+            munmap((void *)from, size);
+        return -1;
+    }
+    size_t pages = copy_pages((uint8_t *)area->area(), from, size);
+    munmap((void *)from, size);
+    // the clone now matches the live area, later edits to it can be committed again
+    c.entry->serial = load_offset(&area->area()->serial);
+    c.entry->bytes_used = load_offset(&area->area()->bytes_used);
+    c.entry->hash = c.hash;
+    print_log("[%s]: %zu of %zu pages written\n", area->context().c_str(), pages,
+              (size + getpagesize() - 1) / getpagesize());
+    return 0;
+}
+
+int run_commit(PropertyStore &store, const char *src)
+{
+    std::string root;
+    std::vector<clone_entry> entries;
+    std::string manifest_path = std::string(src) + "/" PROP_CLONE_MANIFEST;
+    if (!read_manifest(manifest_path, &root, &entries))
+    {
+        fprintf(stderr, "[%s] is missing or not a --clone manifest\n", manifest_path.c_str());
+        return -1;
+    }
+    if (root != real_root(store.root()))
+    {
+        fprintf(stderr, "[%s] is a clone of [%s], not of [%s]\n", src, root.c_str(), real_root(store.root()).c_str());
+        return -1;
+    }
+
+    std::vector<commit_area> changed;
+    size_t unchanged = 0, moved = 0;
+    for (clone_entry &entry : entries)
+    {
+        // init's own word, never written back
+        if (entry.name == PROP_SERIAL_AREA)
+            continue;
+        std::string path = std::string(src) + "/" + entry.name;
+        uint64_t hash;
+        if (!hash_file(path, entry.is_area, &hash))
+        {
+            fprintf(stderr, "can't read [%s]: %s\n", path.c_str(), strerror(errno));
+            return -1;
+        }
+        if (hash == entry.hash)
+        {
+            unchanged++;
+            continue;
+        }
+        if (!entry.is_area)
+        {
+            print_log("[%s] changed, not committed: every process maps it once at start\n", entry.name.c_str());
+            continue;
+        }
+        AreaHandle *area = NULL;
+        for (size_t i = 0; i < store.area_count() && area == NULL; i++)
+        {
+            if (store.area_at(i).context() == entry.name)
+                area = &store.area_at(i);
+        }
+        prop_error err = area == NULL ? PROP_ERR_NO_CONTEXT : area->map(false);
+        if (err != PROP_OK)
+        {
+            fprintf(stderr, "no live area for [%s]\n", entry.name.c_str());
+            if (area != NULL)
+                report_error(err, area);
+            return -1;
+        }
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || (size_t)st.st_size != area->size())
+        {
+            fprintf(stderr, "[%s] isn't the size of the live area\n", path.c_str());
+            return -1;
+        }
+        // checked again under the area's write lock right before its pages are copied
+        if (area_moved(*area, entry))
+        {
+            print_log("[%s]: live area changed since the clone (bytes_used %u, cloned at %u)\n",
+                      entry.name.c_str(), load_offset(&area->area()->bytes_used), entry.bytes_used);
+            moved++;
+        }
+        changed.push_back({area, &entry, path, hash});
+    }
+    if (moved > 0)
+    {
+        fprintf(stderr, "%zu changed area(s) also changed live since the clone, nothing committed\n", moved);
+        return 1;
+    }
+
+    int result = 0;
+    size_t written = 0;
+    while (written < changed.size() && (result = commit_area_pages(changed[written])) == 0)
+        written++;
+    if (written > 0 && !write_manifest(manifest_path, root, entries))
+        return -1;
+    if (result != 0)
+    {
+        if (written > 0)
+            fprintf(stderr, "%zu area(s) already written\n", written);
+        return result;
+    }
+    print_log("committed %zu area(s), %zu unchanged\n", written, unchanged);
+    return 0;
+}
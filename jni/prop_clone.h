@@ -0,0 +1,40 @@
+#pragma once
+
+#include "property_store.h"
+
+/**
+ * --clone DEST: copies every area file of a split root, the properties_serial
+ * area and property_info into the directory DEST, so scrubs, imports and
+ * compactions can be tried with --root DEST first. Files are copied in the
+ * kernel (copy_file_range, sendfile across filesystems, read/write last).
+ * An area copy that doesn't hash like the live area afterwards was torn by a
+ * write during the copy and is copied again.
+ *
+ * DEST/clone_manifest records, per file, what the copy was taken from:
+ *
+ *   root /dev/__properties__
+ *   area u:object_r:vendor_prop:s0 0x00000a3c 48820 9f0c6e1d2b7a4410
+ *        (serial and bytes_used for reading only, FNV-1a 64 of the copied
+ *         bytes without the serial word)
+ *   file property_info 61d2c3b4a5968778
+ *
+ * --commit SRC: writes the areas of the clone SRC whose bytes no longer hash
+ * to the manifest back into the root they came from, in place, since every
+ * process keeps its mapping of the live files. Only the pages that differ
+ * are copied, the first page last, keeping the live serial word, which only
+ * init moves; then the manifest takes the new state, so the clone can be
+ * edited and committed again. init moves no per-area serial, so a live
+ * change is told by the bytes: nothing is written when any changed area no
+ * longer hashes to the manifest, and each area is hashed once more under its
+ * write lock right before its pages are copied. Those areas are listed and
+ * the exit code is 1. Lock-free readers may see a half-copied page for
+ * as long as the copy takes. property_info is only compared, the live one
+ * is mapped once by each process and can't be swapped under it.
+ */
+
+#define PROP_CLONE_MANIFEST "clone_manifest"
+// copies of an area that kept changing before giving up
+#define CLONE_RETRIES 5
+
+int run_clone(PropertyStore &store, const char *dest);
+int run_commit(PropertyStore &store, const char *src);
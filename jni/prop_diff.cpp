@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_diff.h"
+
+struct diff_entry
+{
+    std::string_view name;
+    std::string_view value;
+    uint32_t count;
+};
+
+class DiffSource
+{
+public:
+    virtual ~DiffSource() {}
+    virtual bool open() = 0;
+    // next entry in prop_trie_cmp() order, false at the end
+    virtual bool next(diff_entry *entry) = 0;
+};
+
+/** Areas of a PropertyStore, each walked in order and merged through a heap. */
+class StoreSource : public DiffSource
+{
+public:
+    explicit StoreSource(const char *root) : store_(root) {}
+
+    bool open() override
+    {
+        if (store_.open(use_file_) != PROP_OK)
+        {
+            fprintf(stderr, "can't find any property area in [%s]!\n", store_.root().c_str());
+            return false;
+        }
+        for (AreaHandle &area : store_)
+        {
+            if (area.map(false) != PROP_OK)
+                continue;
+            auto it = area.sorted_begin();
+            if (it != area.sorted_end())
+                heads_.push_back(it);
+        }
+        std::make_heap(heads_.begin(), heads_.end(), heap_greater);
+        return true;
+    }
+
+    bool next(diff_entry *entry) override
+    {
+        if (heads_.empty())
+            return false;
+        std::pop_heap(heads_.begin(), heads_.end(), heap_greater);
+        PropertyRef ref = *heads_.back();
+        entry->name = ref.name();
+        entry->value = ref.value();
+        entry->count = ref.count();
+        ++heads_.back();
+        if (heads_.back() == AreaHandle::sorted_iterator())
+            heads_.pop_back();
+        else
+            std::push_heap(heads_.begin(), heads_.end(), heap_greater);
+        return true;
+    }
+
+    void use_contexts_file(bool use_file) { use_file_ = use_file; }
+
+private:
+    static bool heap_greater(const AreaHandle::sorted_iterator &a, const AreaHandle::sorted_iterator &b)
+    {
+        PropertyRef x = *a, y = *b;
+        return prop_trie_cmp(x.name(), strlen(x.name()), y.name(), strlen(y.name())) > 0;
+    }
+
+    PropertyStore store_;
+    bool use_file_ = false;
+    std::vector<AreaHandle::sorted_iterator> heads_;
+};
+
+/**
+ * "[name]: [value]" lines as printed by dump/get, with optional
+ * " count: N", " serial: 0x..." and " context: [...]" after the value.
+ * The file is mmapped; only the line offsets are kept and sorted.
+ */
+class DumpSource : public DiffSource
+{
+public:
+    explicit DumpSource(const char *path) : path_(path), data_(NULL), size_(0), pos_(0) {}
+    ~DumpSource()
+    {
+        if (data_ != NULL)
+            munmap((void *)data_, size_);
+    }
+
+    bool open() override
+    {
+        int fd = ::open(path_, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            fprintf(stderr, "open file[%s] error[%d]:%s\n", path_, errno, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0)
+        {
+            close(fd);
+            return false;
+        }
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return true;
+        }
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+        {
+            perror("map failed!");
+            return false;
+        }
+        data_ = (const char *)addr;
+        size_ = st.st_size;
+
+        const char *end = data_ + size_;
+        for (const char *line = data_; line < end;)
+        {
+            const char *eol = (const char *)memchr(line, '\n', end - line);
+            if (eol == NULL)
+                eol = end;
+            diff_entry entry;
+            if (parse_line(line, eol, &entry))
+                lines_.push_back({(uint32_t)(line - data_), (uint32_t)(eol - line),
+                                  (uint32_t)(entry.name.data() - data_), (uint32_t)entry.name.size()});
+            line = eol + 1;
+        }
+        // stable, so of several lines for one name the last one stays last
+        std::stable_sort(lines_.begin(), lines_.end(), [this](const line_ref &a, const line_ref &b) {
+            return prop_trie_cmp(data_ + a.name_off, a.name_len, data_ + b.name_off, b.name_len) < 0;
+        });
+        return true;
+    }
+
+    bool next(diff_entry *entry) override
+    {
+        if (pos_ >= lines_.size())
+            return false;
+        // a name listed twice keeps its last line
+        while (pos_ + 1 < lines_.size() && same_name(lines_[pos_], lines_[pos_ + 1]))
+            pos_++;
+        const line_ref &line = lines_[pos_++];
+        parse_line(data_ + line.off, data_ + line.off + line.len, entry);
+        return true;
+    }
+
+private:
+    struct line_ref
+    {
+        uint32_t off;
+        uint32_t len;
+        uint32_t name_off;
+        uint32_t name_len;
+    };
+
+    bool same_name(const line_ref &a, const line_ref &b) const
+    {
+        return a.name_len == b.name_len && memcmp(data_ + a.name_off, data_ + b.name_off, a.name_len) == 0;
+    }
+
+    static bool parse_line(const char *line, const char *eol, diff_entry *entry)
+    {
+        std::string_view sv(line, eol - line);
+        // "set [name]: ..." lines printed after a write
+        if (sv.substr(0, 4) == "set ")
+            sv.remove_prefix(4);
+        while (!sv.empty() && (sv.back() == '\r' || sv.back() == ' '))
+            sv.remove_suffix(1);
+        if (sv.size() < 6 || sv[0] != '[')
+            return false;
+        size_t name_end = sv.find("]: [");
+        if (name_end == std::string_view::npos || name_end == 1)
+            return false;
+        entry->name = sv.substr(1, name_end - 1);
+        sv.remove_prefix(name_end + 4);
+        // values may contain ']', the one that closes the value ends the line or starts a known field
+        size_t close = 0;
+        for (;; close++)
+        {
+            close = sv.find(']', close);
+            if (close == std::string_view::npos)
+                return false;
+            std::string_view rest = sv.substr(close + 1);
+            if (rest.empty() || rest.substr(0, 6) == " count" || rest.substr(0, 7) == " serial" ||
+                rest.substr(0, 8) == " context")
+                break;
+        }
+        entry->value = sv.substr(0, close);
+        entry->count = 0;
+        std::string_view rest = sv.substr(close + 1);
+        if (rest.substr(0, 6) == " count")
+        {
+            rest.remove_prefix(6);
+            if (!rest.empty() && rest[0] == ':')
+                rest.remove_prefix(1);
+            while (!rest.empty() && rest[0] == ' ')
+                rest.remove_prefix(1);
+            uint32_t count = 0;
+            for (size_t i = 0; i < rest.size() && rest[i] >= '0' && rest[i] <= '9'; i++)
+                count = count * 10 + (rest[i] - '0');
+            entry->count = count & PROP_COUNT_MAX;
+        }
+        return true;
+    }
+
+    const char *path_;
+    const char *data_;
+    size_t size_;
+    std::vector<line_ref> lines_;
+    size_t pos_;
+};
+
+// "live", the default area path, an area directory or a single area file are read as areas
+static std::unique_ptr<DiffSource> make_source(const char *side, bool use_contexts_file)
+{
+    const char *root = NULL;
+    struct stat st;
+    if (strcmp(side, "live") == 0)
+        root = PROPERTIES_FILE;
+    else if (stat(side, &st) == 0 && (S_ISDIR(st.st_mode) || probe_area_file(side) != AREA_FORMAT_UNKNOWN))
+        root = side;
+    if (root == NULL)
+        return std::unique_ptr<DiffSource>(new DumpSource(side));
+    StoreSource *source = new StoreSource(root);
+    source->use_contexts_file(use_contexts_file);
+    return std::unique_ptr<DiffSource>(source);
+}
+
+int run_diff(const char *side_a, const char *side_b, bool use_contexts_file)
+{
+    std::unique_ptr<DiffSource> a = make_source(side_a, use_contexts_file);
+    std::unique_ptr<DiffSource> b = make_source(side_b, use_contexts_file);
+    if (!a->open() || !b->open())
+        return -1;
+
+    size_t added = 0, removed = 0, changed = 0, recounted = 0;
+    diff_entry x, y;
+    bool has_x = a->next(&x);
+    bool has_y = b->next(&y);
+    while (has_x || has_y)
+    {
+        int cmp = !has_x ? 1 : !has_y ? -1 : prop_trie_cmp(x.name.data(), x.name.size(), y.name.data(), y.name.size());
+        if (cmp < 0)
+        {
+            print_log("- [%.*s]: [%.*s]\n", (int)x.name.size(), x.name.data(), (int)x.value.size(), x.value.data());
+            removed++;
+            has_x = a->next(&x);
+            continue;
+        }
+        if (cmp > 0)
+        {
+            print_log("+ [%.*s]: [%.*s]\n", (int)y.name.size(), y.name.data(), (int)y.value.size(), y.value.data());
+            added++;
+            has_y = b->next(&y);
+            continue;
+        }
+        if (x.value != y.value)
+        {
+            print_log("~ [%.*s]: [%.*s] -> [%.*s]\n", (int)x.name.size(), x.name.data(),
+                      (int)x.value.size(), x.value.data(), (int)y.value.size(), y.value.data());
+            changed++;
+        }
+        // a counter that moved along with the value is reported too
+        if (x.count != y.count)
+        {
+            print_log("# [%.*s]: count %u -> %u\n", (int)x.name.size(), x.name.data(), x.count, y.count);
+            recounted++;
+        }
+        has_x = a->next(&x);
+        has_y = b->next(&y);
+    }
+    print_log("added %zu removed %zu changed %zu counter %zu\n", added, removed, changed, recounted);
+    return added + removed + changed + recounted == 0 ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+ * --diff A B: compares two property sets. Each side is "live" (the running
+ * device), a --root style image (directory of areas or a pre-N area file) or
+ * a text dump saved from "system_properties all".
+ *
+ * Both sides are walked in prop_trie_cmp() order and merge joined, so areas
+ * are read in place and a dump file is only indexed, never copied:
+ *
+ *   + [name]: [value]              only in B
+ *   - [name]: [value]              only in A
+ *   ~ [name]: [old] -> [new]       value differs
+ *   # [name]: count old -> new     counter differs, after the ~ line when the value differs too
+ *
+ * Returns 0 when both sides are equal, 1 when they differ, -1 on error.
+ */
+int run_diff(const char *side_a, const char *side_b, bool use_contexts_file);
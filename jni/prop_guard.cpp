@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "system_properties.h"
+#include "prop_guard.h"
+
+static volatile sig_atomic_t g_guard_stop = 0;
+
+static void on_stop_signal(int)
+{
+    g_guard_stop = 1;
+}
+
+struct guard_stats
+{
+    size_t wakeups;
+    size_t rescans;
+    size_t fixes;
+};
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_ms(int ms)
+{
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static const guard_rule *match_rule(const std::vector<guard_rule> &rules, const char *name)
+{
+    for (auto &rule : rules)
+    {
+        if (match_prop_name(rule.pattern, name))
+            return &rule;
+    }
+    return NULL;
+}
+
+// one walk of area, the matches with a wrong counter are set per target count
+static void fix_area(PropertyStore &store, AreaHandle &area, const std::vector<guard_rule> &rules,
+                     guard_stats &stats)
+{
+    stats.rescans++;
+    std::vector<std::pair<uint32_t, PropertyRef>> wrong;
+    for (PropertyRef ref : area)
+    {
+        const guard_rule *rule = match_rule(rules, ref.name());
+        if (rule != NULL && ref.count() != rule->count)
+            wrong.push_back({rule->count, ref});
+    }
+    std::sort(wrong.begin(), wrong.end(), [](auto &a, auto &b) { return a.first < b.first; });
+    for (size_t begin = 0; begin < wrong.size();)
+    {
+        size_t end = begin;
+        std::vector<PropertyRef> refs;
+        std::vector<uint32_t> old_counts;
+        for (; end < wrong.size() && wrong[end].first == wrong[begin].first; end++)
+        {
+            refs.push_back(wrong[end].second);
+            old_counts.push_back(wrong[end].second.count());
+        }
+        std::vector<bool> changed;
+        prop_error err = store.set_counts(refs, wrong[begin].first, &changed);
+        if (err != PROP_OK)
+            report_error(err, &area);
+        for (size_t i = 0; i < refs.size(); i++)
+        {
+            if (!changed[i])
+                continue;
+            stats.fixes++;
+            print_log("fixed [%s] count %u -> %u\n", refs[i].name(), old_counts[i], refs[i].count());
+        }
+        begin = end;
+    }
+}
+
+/**
+ * Walks every area whose content hash differs from the one seen at its last
+ * walk. The hash is taken before the walk, so a change that lands during it,
+ * and the guard's own fixes, leave the area to be walked again next time.
+ */
+static void fix_changed_areas(PropertyStore &store, const std::vector<AreaHandle *> &areas,
+                              std::vector<uint64_t> &seen, const std::vector<guard_rule> &rules,
+                              guard_stats &stats)
+{
+    for (size_t i = 0; i < areas.size(); i++)
+    {
+        uint64_t hash = areas[i]->content_hash();
+        if (hash == seen[i])
+            continue;
+        seen[i] = hash;
+        fix_area(store, *areas[i], rules, stats);
+    }
+}
+
+static void print_stats(const guard_stats &stats, int64_t start)
+{
+    double seconds = std::max(1e-3, (now_ns() - start) / 1e9);
+    print_log("guard %.1f s: wakeups %zu (%.2f/s) rescans %zu fixes %zu (%.2f/s)\n", seconds, stats.wakeups,
+              stats.wakeups / seconds, stats.rescans, stats.fixes, stats.fixes / seconds);
+}
+
+int run_guard(PropertyStore &store, const std::vector<guard_rule> &rules, int timeout_ms)
+{
+    std::vector<AreaHandle *> areas;
+    for (AreaHandle &area : store)
+    {
+        prop_error err = area.map(false);
+        if (err != PROP_OK)
+        {
+            report_error(err, &area);
+            continue;
+        }
+        if (area.format() == AREA_FORMAT_TRIE && area.context() != PROP_SERIAL_AREA)
+            areas.push_back(&area);
+    }
+    if (areas.empty())
+    {
+        fprintf(stderr, "no writable property area to guard\n");
+        return -1;
+    }
+    AreaHandle *serial_area = store.serial_area();
+    if (serial_area != NULL && serial_area->map(false) != PROP_OK)
+        serial_area = NULL;
+    // with no word every change moves, the only area's own serial will do, more areas are polled
+    const uint32_t *word = serial_area != NULL ? &serial_area->area()->serial
+                           : areas.size() == 1 ? &areas[0]->area()->serial
+                                               : NULL;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    guard_stats stats = {0, 0, 0};
+    int64_t start = now_ns();
+    int64_t stop_at = timeout_ms < 0 ? INT64_MAX : start + timeout_ms * 1000000LL;
+    int64_t report_at = start + GUARD_REPORT_SECONDS * 1000000000LL;
+    std::vector<uint64_t> seen(areas.size());
+    // read before the hashes: a change after that moves the word away from it
+    uint32_t scanned_word = word != NULL ? load_offset(word) : 0;
+    for (size_t i = 0; i < areas.size(); i++)
+    {
+        seen[i] = areas[i]->content_hash();
+        fix_area(store, *areas[i], rules, stats);
+    }
+    if (g_verbose_mode)
+        fprintf(stderr, "guarding %zu rules over %zu areas, %s\n", rules.size(), areas.size(),
+                serial_area != NULL ? "woken by the serial area" : word != NULL ? "woken by the area" : "polling");
+
+    while (!g_guard_stop)
+    {
+        int64_t now = now_ns();
+        if (now >= stop_at)
+            break;
+        if (now >= report_at)
+        {
+            print_stats(stats, start);
+            report_at += GUARD_REPORT_SECONDS * 1000000000LL;
+        }
+        int64_t wait_ns = std::min(stop_at, report_at) - now;
+        if (word == NULL)
+            wait_ns = std::min<int64_t>(wait_ns, GUARD_POLL_MS * 1000000LL);
+        struct timespec ts = {(time_t)(wait_ns / 1000000000LL), (long)(wait_ns % 1000000000LL)};
+
+        // a word that moved since the last pass read it means a change that pass may have missed
+        if (word == NULL)
+        {
+            nanosleep(&ts, NULL);
+            stats.wakeups++;
+        }
+        else if (load_offset(word) == scanned_word)
+        {
+            if (prop_futex_wait(word, scanned_word, &ts) < 0 && errno != EAGAIN)
+                continue; // timeout or signal
+            stats.wakeups++;
+        }
+        // a burst of changes: wait for the word to stay put, but not forever
+        for (int round = 0; word != NULL && round < GUARD_SETTLE_MAX_ROUNDS && !g_guard_stop; round++)
+        {
+            uint32_t before = load_offset(word);
+            sleep_ms(GUARD_SETTLE_MS);
+            if (load_offset(word) == before)
+                break;
+        }
+        // init moves no per-area serial, so which areas changed is told by their bytes
+        scanned_word = word != NULL ? load_offset(word) : 0;
+        fix_changed_areas(store, areas, seen, rules, stats);
+    }
+    print_stats(stats, start);
+    return 0;
+}
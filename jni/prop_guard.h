@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "property_store.h"
+
+/**
+ * --guard PATTERN=COUNT...: keeps the counters of the matching properties
+ * at COUNT for as long as it runs, instead of a cron loop of -c.
+ *
+ * After one full pass it sleeps on a futex on the properties_serial area's
+ * serial, which init moves on every change (on the only area's serial when
+ * there is one area and no serial area, else it re-checks every
+ * GUARD_POLL_MS). After a wake it waits until the word stays put for
+ * GUARD_SETTLE_MS, so a burst of setprops costs one rescan. init never
+ * moves a per-area serial, so every guarded area is then hashed with
+ * AreaHandle::content_hash() and only the ones whose hash differs from their
+ * last walk are walked again, with the counters put back through
+ * set_counts(). Its own writes move no serial and cost no wake; the areas
+ * they changed are walked once more at the next wake.
+ *
+ * Every fix is printed, wake-up/rescan/fix counts and rates every
+ * GUARD_REPORT_SECONDS and on exit. Runs until SIGINT/SIGTERM, or for
+ * timeout_ms when that is >= 0. The first matching rule wins.
+ */
+
+#define GUARD_SETTLE_MS 20
+#define GUARD_POLL_MS 1000
+#define GUARD_REPORT_SECONDS 60
+// a steady stream of changes still gets a rescan after this many settle periods
+#define GUARD_SETTLE_MAX_ROUNDS 10
+
+struct guard_rule
+{
+    std::string pattern;
+    uint32_t count;
+};
+
+int run_guard(PropertyStore &store, const std::vector<guard_rule> &rules, int timeout_ms);
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_transaction.h"
+#include "prop_import.h"
+
+struct import_entry
+{
+    std::string name;
+    std::string value;
+    AreaHandle *area;
+    bool missing;   // not in its area yet, so applying it creates it
+};
+
+static std::string_view trim(const char *begin, const char *end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+        begin++;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+    return std::string_view(begin, end - begin);
+}
+
+// later files and later lines win, like init loading build.prop files in order
+static bool scan_prop_file(const char *file_name, std::vector<import_entry> &entries,
+                           std::unordered_map<std::string, size_t> &index)
+{
+    int fd = open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "open file[%s] error[%d]:%s\n", file_name, errno, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    const char *data = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("map failed!");
+        return false;
+    }
+
+    const char *end = data + st.st_size;
+    for (const char *line = data; line < end;)
+    {
+        const char *eol = (const char *)memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+        std::string_view sv = trim(line, eol);
+        line = eol + 1;
+        if (sv.empty() || sv[0] == '#')
+            continue;
+        size_t eq = sv.find('=');
+        if (eq == std::string_view::npos)
+            continue; // "import ..." and other directives
+        std::string_view key = trim(sv.data(), sv.data() + eq);
+        std::string_view value = trim(sv.data() + eq + 1, sv.data() + sv.size());
+        if (key.empty())
+            continue;
+        std::string name(key);
+        auto it = index.find(name);
+        if (it != index.end())
+        {
+            entries[it->second].value = value;
+            continue;
+        }
+        index.emplace(name, entries.size());
+        entries.push_back({name, std::string(value), nullptr, false});
+    }
+    munmap((void *)data, st.st_size);
+    return true;
+}
+
+int run_import(PropertyStore &store, char **files, int file_count, uint32_t prop_count, bool need_confirm,
+               const char *journal_path, TraceRecorder &recorder)
+{
+    std::vector<import_entry> entries;
+    std::unordered_map<std::string, size_t> index;
+    for (int i = 0; i < file_count; i++)
+    {
+        if (!scan_prop_file(files[i], entries, index))
+            return -1;
+    }
+
+    size_t skipped = 0;
+    size_t missing = 0;
+    std::vector<import_entry *> targets;
+    for (auto &entry : entries)
+    {
+        // an empty segment would leave nodes bionic can never reach
+        if (!prop_name_valid(entry.name))
+        {
+            fprintf(stderr, "[%s]: invalid property name, skipped\n", entry.name.c_str());
+            skipped++;
+            continue;
+        }
+        if (entry.value.size() >= PROP_VALUE_MAX)
+        {
+            fprintf(stderr, "[%s]: value is too long, need less %d, skipped\n", entry.name.c_str(), PROP_VALUE_MAX);
+            skipped++;
+            continue;
+        }
+        prop_error err = store.area_for(entry.name.c_str(), false, &entry.area);
+        if (err != PROP_OK)
+        {
+            fprintf(stderr, "[%s]: %s, skipped\n", entry.name.c_str(), prop_strerror(err));
+            skipped++;
+            continue;
+        }
+        PropertyRef ref;
+        entry.missing = entry.area->find(entry.name.c_str(), &ref) == PROP_ERR_NOT_FOUND;
+        missing += entry.missing;
+        targets.push_back(&entry);
+    }
+
+    if (missing > 0 && need_confirm)
+    {
+        printf("%zu props don't exist, create them? y*/n\n", missing);
+        char ans = getchar();
+        // a no only drops the creations, the entries for existing properties still apply
+        if (ans == 'n' || ans == 'N')
+        {
+            targets.erase(std::remove_if(targets.begin(), targets.end(),
+                                         [](const import_entry *entry) { return entry->missing; }),
+                          targets.end());
+            skipped += missing;
+            printf("%zu missing props skipped\n", missing);
+        }
+    }
+
+    // grouped by area so planning walks one area at a time
+    std::stable_sort(targets.begin(), targets.end(), [](const import_entry *a, const import_entry *b) {
+        return a->area < b->area;
+    });
+    recorder.start();
+    PropertyTransaction transaction(store);
+    for (auto *entry : targets)
+        transaction.add(entry->name.c_str(), entry->value.c_str(), prop_count, true);
+
+    prop_error err = transaction.plan();
+    print_area_plans(transaction);
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "[%s]: %s, nothing changed\n",
+                transaction.changes()[transaction.failed_index()].name.c_str(), prop_strerror(err));
+        return -1;
+    }
+    if (journal_path != NULL && (err = transaction.write_journal(journal_path)) != PROP_OK)
+    {
+        fprintf(stderr, "can't write journal [%s]: %s, nothing changed\n", journal_path, strerror(errno));
+        return -1;
+    }
+    // unchanged entries are never written, an area without changes stays mapped read-only
+    size_t changed = 0;
+    err = transaction.apply(&changed);
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "[%s]: %s\n", transaction.changes()[transaction.failed_index()].name.c_str(),
+                prop_strerror(err));
+        return -1;
+    }
+    recorder.finish_batch(transaction.changes());
+
+    size_t updated = 0, created = 0, unchanged = 0;
+    for (auto &change : transaction.changes())
+    {
+        if (!change.effective)
+        {
+            unchanged++;
+            continue;
+        }
+        change.offset == 0 ? created++ : updated++;
+        PropertyRef ref;
+        if (store.get(change.name.c_str(), &ref) == PROP_OK)
+            print_property(store, ref, prop_count, true);
+    }
+    print_log("changed %zu unchanged %zu created %zu skipped %zu\n", updated, unchanged, created, skipped);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "property_store.h"
+#include "prop_trace.h"
+
+/**
+ * --import: applies build.prop style files (key=value lines, '#' comments,
+ * "import" directives ignored) as one transaction. Only entries whose value
+ * differs from the area are written, missing properties are created. Each
+ * property written goes to recorder.
+ */
+int run_import(PropertyStore &store, char **files, int file_count, uint32_t prop_count, bool need_confirm,
+               const char *journal_path, TraceRecorder &recorder);
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+
+#include <string>
+
+#include "system_properties.h"
+#include "property_info.h"
+#include "property_info_builder.h"
+#include "prop_info_build.h"
+
+int run_info_build(const char *out, const char *base, char **files, int file_count,
+                   const std::vector<const char *> &rules, const std::vector<const char *> &drops)
+{
+    PropertyInfoBuilder builder;
+    std::vector<std::string> errors;
+    if (file_count == 0)
+    {
+        prop_error err = builder.load(base);
+        if (err != PROP_OK)
+        {
+            fprintf(stderr, "can't read property_info [%s]: %s\n", base,
+                    err == PROP_ERR_OPEN ? strerror(errno) : prop_strerror(err));
+            return -1;
+        }
+    }
+    for (int i = 0; i < file_count; i++)
+    {
+        if (builder.load_contexts(files[i], &errors) != PROP_OK)
+        {
+            fprintf(stderr, "can't read [%s]: %s\n", files[i], strerror(errno));
+            return -1;
+        }
+    }
+    for (const char *name : drops)
+    {
+        if (!builder.remove(name))
+            errors.push_back(std::string("--info-drop ") + name + ": no rule for it");
+    }
+    for (const char *line : rules)
+    {
+        property_info_rule rule;
+        std::string error;
+        if (!parse_property_info_line(line, &rule, &error) || !builder.add(rule, true, &error))
+            errors.push_back(std::string("--info-rule ") + line + ": " + error);
+    }
+    if (!errors.empty())
+    {
+        for (const std::string &error : errors)
+            fprintf(stderr, "%s\n", error.c_str());
+        fprintf(stderr, "%zu error(s), [%s] not written\n", errors.size(), out);
+        return -1;
+    }
+
+    if (builder.write(out) != PROP_OK)
+    {
+        fprintf(stderr, "can't write [%s]: %s\n", out, strerror(errno));
+        return -1;
+    }
+    // read back with the lookup code, a file it can't open is no use on the device
+    property_info written(out);
+    if (!written.is_valid())
+    {
+        fprintf(stderr, "[%s] written but can't be read back!\n", out);
+        return -1;
+    }
+    if (g_verbose_mode)
+        written.print();
+    struct stat st;
+    stat(out, &st);
+    print_log("[%s]: %zu contexts, %zu types, %zu nodes, %lld bytes\n", out, builder.context_count(),
+              builder.type_count(), builder.node_count(), (long long)st.st_size);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * --info-build OUT [FILE...]: writes a property_info image (the context
+ * index init builds at boot) to OUT, for trying another property->context
+ * layout on a --root copy.
+ *
+ * The rules come from the property_contexts FILEs in order, as init reads
+ * its plat/vendor/... files, or, without FILEs, from the image already at
+ * base. Then the edits apply: each --info-drop NAME removes the rules for
+ * NAME ("a.b." the node rule), each --info-rule "NAME CONTEXT [exact|prefix]
+ * [TYPE]" adds its rule or replaces the one with the same name and match.
+ * Any malformed line, duplicate or drop without a rule fails the whole run
+ * and OUT is left alone. -v prints the trie written.
+ */
+int run_info_build(const char *out, const char *base, char **files, int file_count,
+                   const std::vector<const char *> &rules, const std::vector<const char *> &drops);
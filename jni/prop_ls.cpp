@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_ls.h"
+#include "prop_stats.h"
+
+struct ls_entry
+{
+    int level;
+    bool is_prop;
+    std::string value;
+    uint32_t props;
+    bool truncated;
+};
+
+struct ls_subtree
+{
+    uint32_t props;
+    bool truncated;
+};
+
+struct trie_less
+{
+    bool operator()(const std::string &a, const std::string &b) const
+    {
+        return prop_trie_cmp(a.data(), a.size(), b.data(), b.size()) < 0;
+    }
+};
+
+typedef std::map<std::string, ls_entry, trie_less> ls_tree;
+
+static std::string join(const std::string &prefix, const char *segment, size_t len)
+{
+    std::string name = prefix;
+    if (!name.empty())
+        name += '.';
+    name.append(segment, len);
+    return name;
+}
+
+// every node of the BST rooted at off is one segment of level; returns what they hold within max_depth
+static ls_subtree walk_level(AreaHandle &area, uint32_t off, const std::string &prefix, int level, int max_depth,
+                             ls_tree &tree, uint32_t *nodes)
+{
+    ls_subtree total = {0, false};
+    std::vector<uint32_t> pending = {off};
+    while (!pending.empty())
+    {
+        prop_bt *p_bt = area.get_prop_bt(pending.back());
+        pending.pop_back();
+        if (p_bt == NULL)
+            continue;
+        (*nodes)++;
+        uint32_t left = load_offset(&p_bt->left);
+        uint32_t right = load_offset(&p_bt->right);
+        if (left != 0)
+            pending.push_back(left);
+        if (right != 0)
+            pending.push_back(right);
+
+        std::string name = join(prefix, p_bt->name, p_bt->namelen);
+        ls_subtree sub = {0, false};
+        uint32_t prop = load_offset(&p_bt->prop);
+        prop_info *info = prop == 0 ? NULL : area.get_prop_info(prop);
+        uint32_t children = load_offset(&p_bt->children);
+        if (children != 0)
+        {
+            if (max_depth == 0 || level < max_depth)
+                sub = walk_level(area, children, name, level + 1, max_depth, tree, nodes);
+            else
+                sub.truncated = true;
+        }
+        ls_entry &entry = tree.try_emplace(name, ls_entry{level, false, "", 0, false}).first->second;
+        if (info != NULL)
+        {
+            entry.is_prop = true;
+            entry.value = info->value;
+            sub.props++;
+        }
+        entry.props += sub.props;
+        entry.truncated |= sub.truncated;
+        total.props += sub.props;
+        total.truncated |= sub.truncated;
+    }
+    return total;
+}
+
+// pre-4.4 areas: the same entries from the flat name list
+static void list_compat(AreaHandle &area, const std::string &prefix, int max_depth, ls_tree &tree)
+{
+    for (PropertyRef ref : area)
+    {
+        std::string_view name(ref.name());
+        if (!prefix.empty() && !(name.starts_with(prefix) && name.size() > prefix.size() && name[prefix.size()] == '.'))
+            continue;
+        size_t pos = prefix.empty() ? 0 : prefix.size() + 1;
+        // like the trie walk: a property below the limit only marks the levels above it
+        int levels = 1;
+        for (size_t i = pos; i < name.size(); i++)
+            levels += name[i] == '.';
+        bool counted = max_depth == 0 || levels <= max_depth;
+        for (int level = 1; level <= levels && (max_depth == 0 || level <= max_depth); level++)
+        {
+            size_t dot = name.find('.', pos);
+            size_t end = dot == std::string_view::npos ? name.size() : dot;
+            ls_entry &entry = tree.try_emplace(std::string(name.substr(0, end)), ls_entry{level, false, "", 0, false})
+                                  .first->second;
+            entry.props += counted;
+            entry.truncated |= !counted;
+            if (level == levels)
+            {
+                entry.is_prop = true;
+                entry.value = ref.value();
+            }
+            pos = end + 1;
+        }
+    }
+}
+
+int run_ls(PropertyStore &store, const char *prefix, int depth)
+{
+    std::string base(prefix);
+    while (!base.empty() && base.back() == '.')
+        base.pop_back();
+    ls_tree tree;
+    uint32_t nodes = 0;
+    size_t areas = 0;
+    for (AreaHandle &area : store)
+    {
+        prop_error err = area.map(false);
+        if (err != PROP_OK)
+        {
+            report_error(err, &area);
+            continue;
+        }
+        if (area.format() == AREA_FORMAT_COMPAT)
+        {
+            list_compat(area, base, depth, tree);
+            areas++;
+            continue;
+        }
+        prop_bt *p_bt = area.find_prefix(base.c_str(), &nodes);
+        uint32_t children = p_bt == NULL ? 0 : load_offset(&p_bt->children);
+        if (children == 0)
+            continue;
+        walk_level(area, children, base, 1, depth, tree, &nodes);
+        areas++;
+    }
+    if (tree.empty())
+    {
+        fprintf(stderr, "nothing under [%s]\n", base.c_str());
+        return -1;
+    }
+    PROP_STATS_PHASE(PHASE_OUTPUT);
+    for (auto &[name, entry] : tree)
+    {
+        print_log("%*s%s", 2 * (entry.level - 1), "", name.c_str());
+        if (entry.is_prop)
+            print_log(" = [%s]", entry.value.c_str());
+        print_log(" %u%s props\n", entry.props, entry.truncated ? "+" : "");
+    }
+    if (g_verbose_mode)
+        print_log("%u prop_bt read in %zu areas\n", nodes, areas);
+    return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "property_store.h"
+
+/**
+ * --ls PREFIX [--depth N]: the child segments under PREFIX ("" for the top
+ * level) in every area that has PREFIX, merged by name, printed as a tree
+ * in trie order:
+ *
+ *   vendor.audio = [value] 12 props
+ *     vendor.audio.feature 3+ props
+ *
+ * Only the prop_bt nodes of the prefix path and of the N levels below it
+ * are read (N = 0: all levels), so counts are of the properties within
+ * those levels; "+" marks entries with more segments below the limit.
+ * -v reports the number of prop_bt read. Pre-4.4 areas have no trie and
+ * are listed from their names.
+ */
+
+#define LS_DEFAULT_DEPTH 1
+
+int run_ls(PropertyStore &store, const char *prefix, int depth);
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_bionic.h"
+#include "prop_reader_bench.h"
+
+struct bench_result
+{
+    std::vector<uint32_t> ns;
+    uint64_t nodes;
+    uint32_t max_nodes;
+    size_t misses;
+    size_t backup_reads;
+};
+
+static inline uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// median cost of the two clock reads around a lookup
+static uint32_t clock_overhead()
+{
+    std::vector<uint32_t> samples(10000);
+    for (auto &s : samples)
+    {
+        uint64_t start = now_ns();
+        s = now_ns() - start;
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+static void read_value(void *cookie, const char *, const char *value, uint32_t)
+{
+    *(size_t *)cookie += strlen(value);
+}
+
+// the same name with its last segment one byte longer
+static std::string miss_name(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    size_t prefix = dot == NULL ? 0 : dot + 1 - name;
+    std::string miss(name, prefix);
+    miss += 'x';
+    miss += name + prefix;
+    return miss;
+}
+
+// returns the number of properties in area
+static size_t bench_area(AreaHandle &area, int lookups, uint32_t overhead, bench_result &result)
+{
+    std::vector<const char *> names;
+    for (PropertyRef ref : area)
+        names.push_back(ref.name());
+    if (names.empty())
+        return 0;
+    std::mt19937 rng(1);
+    std::shuffle(names.begin(), names.end(), rng);
+    std::vector<std::string> misses;
+    for (size_t i = 0; i < names.size(); i++)
+        misses.push_back(miss_name(names[i]));
+
+    // drawn up front so the timed loop only looks up
+    std::vector<double> weights(names.size());
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.0 / (i + 1);
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<const char *> plan(lookups);
+    for (auto &name : plan)
+    {
+        size_t rank = zipf(rng);
+        name = percent(rng) < READER_BENCH_MISS_PERCENT ? misses[rank].c_str() : names[rank];
+    }
+
+    const prop_area *pa = area.area();
+    size_t sink = 0;
+    uint32_t nodes;
+    bool from_backup;
+    // one untimed pass faults the pages in
+    for (const char *name : names)
+        bionic_find(pa, name, &nodes);
+    size_t first = result.ns.size();
+    result.ns.reserve(first + lookups);
+    for (const char *name : plan)
+    {
+        uint64_t start = now_ns();
+        const prop_info *pi = bionic_find(pa, name, &nodes);
+        if (pi != NULL && !bionic_read_callback(pa, pi, read_value, &sink, &from_backup))
+            pi = NULL;
+        uint64_t elapsed = now_ns() - start;
+        result.ns.push_back(elapsed > overhead ? elapsed - overhead : 0);
+        result.nodes += nodes;
+        result.max_nodes = std::max(result.max_nodes, nodes);
+        result.misses += pi == NULL;
+        result.backup_reads += pi != NULL && from_backup;
+    }
+    return names.size();
+}
+
+static void print_result(const char *label, size_t props, bench_result &result)
+{
+    size_t n = result.ns.size();
+    if (n == 0)
+        return;
+    uint64_t sum = 0;
+    for (uint32_t ns : result.ns)
+        sum += ns;
+    std::sort(result.ns.begin(), result.ns.end());
+    auto pct = [&](double p) { return result.ns[std::min(n - 1, (size_t)(p * n))]; };
+    print_log("%s: props %zu lookups %zu miss %zu backup %zu nodes avg %.1f max %u ns avg %.0f p50 %u p99 %u "
+              "p99.9 %u max %u\n",
+              label, props, n, result.misses, result.backup_reads, (double)result.nodes / n, result.max_nodes,
+              (double)sum / n, pct(0.5), pct(0.99), pct(0.999), result.ns[n - 1]);
+}
+
+int run_reader_bench(PropertyStore &store, int lookups)
+{
+    uint32_t overhead = clock_overhead();
+    bench_result total = {};
+    size_t total_props = 0;
+    for (AreaHandle &area : store)
+    {
+        prop_error err = area.map(false);
+        if (err != PROP_OK)
+        {
+            report_error(err, &area);
+            continue;
+        }
+        if (area.format() != AREA_FORMAT_TRIE || area.context() == PROP_SERIAL_AREA)
+            continue;
+        bench_result result = {};
+        size_t props = bench_area(area, lookups, overhead, result);
+        total.ns.insert(total.ns.end(), result.ns.begin(), result.ns.end());
+        total.nodes += result.nodes;
+        total.max_nodes = std::max(total.max_nodes, result.max_nodes);
+        total.misses += result.misses;
+        total.backup_reads += result.backup_reads;
+        total_props += props;
+        print_result(area.context().empty() ? area.path().c_str() : area.context().c_str(), props, result);
+    }
+    if (total.ns.empty())
+    {
+        fprintf(stderr, "no trie area with properties to look up\n");
+        return -1;
+    }
+    print_log("clock overhead %u ns subtracted\n", overhead);
+    print_result("all", total_props, total);
+    return 0;
+}
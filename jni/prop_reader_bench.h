@@ -0,0 +1,24 @@
+#pragma once
+
+#include "property_store.h"
+
+/**
+ * --reader-bench[=N]: how fast other processes find and read properties in
+ * each trie area, using the bionic reader copy in prop_bionic.h.
+ *
+ * Per area, N lookups (default READER_BENCH_LOOKUPS) are drawn from a
+ * fixed-seed Zipf distribution over the area's own names in shuffled order,
+ * with READER_BENCH_MISS_PERCENT of them for names that aren't set (an
+ * existing name with its last segment changed, so the walk goes all the way
+ * down). Each lookup is find + read_callback, timed alone with the clock
+ * overhead subtracted. Reported per area and for all of them: average,
+ * p50/p99/p99.9/max ns, prop_bt nodes compared, misses and reads that
+ * bionic would take from the dirty backup area. Nodes compared don't depend
+ * on the machine, so before/after runs of create, delete or rebalance
+ * compare exactly; the times say what that costs on this host.
+ */
+
+#define READER_BENCH_LOOKUPS 100000
+#define READER_BENCH_MISS_PERCENT 10
+
+int run_reader_bench(PropertyStore &store, int lookups);
@@ -0,0 +1,672 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_server.h"
+
+#define SERVE_MAX_EVENTS 64
+
+static volatile sig_atomic_t g_server_stop = 0;
+
+static void on_stop_signal(int)
+{
+    g_server_stop = 1;
+}
+
+static bool make_address(const char *socket_path, struct sockaddr_un *addr, socklen_t *addr_len)
+{
+    size_t len = strlen(socket_path);
+    if (len == 0 || len >= sizeof(addr->sun_path))
+    {
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, socket_path, len);
+    if (socket_path[0] == '@')
+    {
+        addr->sun_path[0] = '\0';
+    }
+    else
+    {
+        len++; // keep the terminating '\0'
+    }
+    *addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+    return true;
+}
+
+static int connect_socket(const char *socket_path)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len;
+    if (!make_address(socket_path, &addr, &addr_len))
+    {
+        fprintf(stderr, "invalid socket path [%s]\n", socket_path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, addr_len) < 0)
+    {
+        fprintf(stderr, "connect [%s] error:%s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void put_u16(std::string &out, uint16_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+static void put_u32(std::string &out, uint32_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+static uint16_t get_u16(const char *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t get_u32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// frame header is written as a placeholder and patched once the payload is known
+static size_t begin_frame(std::string &out, uint8_t type)
+{
+    size_t start = out.size();
+    put_u32(out, 0);
+    out.push_back((char)type);
+    return start;
+}
+
+static void end_frame(std::string &out, size_t start)
+{
+    uint32_t len = out.size() - start - sizeof(uint32_t);
+    memcpy(&out[start], &len, sizeof(len));
+}
+
+static bool is_wildcard(std::string_view pattern)
+{
+    return pattern.starts_with("*") || pattern.ends_with("*");
+}
+
+static bool pattern_match(std::string_view pattern, const char *name)
+{
+    if (!is_wildcard(pattern))
+        return pattern == name;
+    return pattern.size() < 2 || match_prop_name(pattern, name);
+}
+
+static void serve_get(PropertyStore &store, std::string_view name, std::string &out)
+{
+    std::string prop_name(name);
+    PropertyRef ref;
+    size_t frame = begin_frame(out, PROP_OK);
+    prop_error err = store.get(prop_name.c_str(), &ref);
+    if (err == PROP_OK)
+    {
+        put_u32(out, ref.serial());
+        out.append(ref.value());
+    }
+    else
+    {
+        out[frame + sizeof(uint32_t)] = (char)err;
+    }
+    end_frame(out, frame);
+}
+
+static void serve_dump(PropertyStore &store, std::string_view pattern, std::string &out)
+{
+    std::vector<PropertyRef> matched;
+    for (AreaHandle &area : store)
+    {
+        if (area.map(false) != PROP_OK)
+            continue;
+        for (PropertyRef ref : area)
+        {
+            if (pattern_match(pattern, ref.name()))
+                matched.push_back(ref);
+        }
+    }
+    std::sort(matched.begin(), matched.end(), [](const PropertyRef &a, const PropertyRef &b) {
+        return strcmp(a.name(), b.name()) < 0;
+    });
+    size_t frame = begin_frame(out, PROP_OK);
+    for (auto &ref : matched)
+    {
+        size_t name_len = strlen(ref.name());
+        size_t value_len = strnlen(ref.value(), PROP_VALUE_MAX);
+        put_u32(out, ref.serial());
+        put_u16(out, name_len);
+        out.append(ref.name(), name_len);
+        out.push_back((char)value_len);
+        out.append(ref.value(), value_len);
+    }
+    end_frame(out, frame);
+}
+
+static void serve_set_count(PropertyStore &store, uint32_t count, std::string_view pattern, bool may_write,
+                            std::string &out)
+{
+    std::vector<PropertyRef> refs;
+    prop_error status = PROP_OK;
+    if (!may_write)
+    {
+        status = PROP_ERR_PERMISSION;
+    }
+    else if (!is_wildcard(pattern))
+    {
+        PropertyRef ref;
+        status = store.get(std::string(pattern).c_str(), &ref);
+        if (status == PROP_OK)
+            refs.push_back(ref);
+    }
+    else
+    {
+        for (AreaHandle &area : store)
+        {
+            if (area.map(false) != PROP_OK)
+                continue;
+            for (PropertyRef ref : area)
+            {
+                if (pattern_match(pattern, ref.name()))
+                    refs.push_back(ref);
+            }
+        }
+    }
+    std::vector<bool> flags;
+    if (status == PROP_OK)
+        status = store.set_counts(refs, count, &flags);
+    uint32_t matched = refs.size();
+    uint32_t changed = std::count(flags.begin(), flags.end(), true);
+    size_t frame = begin_frame(out, status);
+    put_u32(out, matched);
+    put_u32(out, changed);
+    end_frame(out, frame);
+}
+
+static void serve_request(PropertyStore &store, const char *frame, uint32_t len, bool may_write, std::string &out)
+{
+    uint8_t op = frame[0];
+    std::string_view payload(frame + 1, len - 1);
+    switch (op)
+    {
+    case SERVE_OP_GET:
+        serve_get(store, payload, out);
+        break;
+    case SERVE_OP_DUMP:
+        serve_dump(store, payload, out);
+        break;
+    case SERVE_OP_SET_COUNT:
+        if (payload.size() >= sizeof(uint16_t))
+        {
+            serve_set_count(store, get_u16(payload.data()), payload.substr(sizeof(uint16_t)), may_write, out);
+            break;
+        }
+        [[fallthrough]];
+    default:
+        end_frame(out, begin_frame(out, PROP_ERR_INVALID));
+        break;
+    }
+}
+
+struct serve_client
+{
+    std::string in;
+    std::string out;
+    size_t out_pos = 0;
+    bool may_write = false;
+};
+
+// root and shell, like setprop; the daemon's own uid for fixture roots run unprivileged
+static bool peer_may_write(int fd)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+        return false;
+    return cred.uid == 0 || cred.uid == SERVE_SHELL_UID || cred.uid == geteuid();
+}
+
+static bool flush_client(int fd, serve_client &client)
+{
+    while (client.out_pos < client.out.size())
+    {
+        ssize_t n = send(fd, client.out.data() + client.out_pos, client.out.size() - client.out_pos,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (n <= 0)
+            return false;
+        client.out_pos += n;
+    }
+    client.out.clear();
+    client.out_pos = 0;
+    return true;
+}
+
+// room for two whole request frames, anything beyond waits in the socket
+#define SERVE_INPUT_MAX (2 * (sizeof(uint32_t) + SERVE_REQUEST_MAX))
+
+// returns false when the client is gone
+static bool read_client(int fd, serve_client &client)
+{
+    char buffer[8192];
+    while (client.in.size() < SERVE_INPUT_MAX)
+    {
+        ssize_t n = recv(fd, buffer, std::min(sizeof(buffer), SERVE_INPUT_MAX - client.in.size()), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return false;
+        client.in.append(buffer, n);
+    }
+    return true;
+}
+
+// serves the complete frames while the queued output stays under SERVE_OUTPUT_MAX, false on a broken frame
+static bool serve_pending(PropertyStore &store, serve_client &client)
+{
+    size_t pos = 0;
+    while (client.in.size() - pos >= sizeof(uint32_t) && client.out.size() < SERVE_OUTPUT_MAX)
+    {
+        uint32_t len = get_u32(client.in.data() + pos);
+        if (len == 0 || len > SERVE_REQUEST_MAX)
+            return false;
+        if (client.in.size() - pos - sizeof(uint32_t) < len)
+            break;
+        serve_request(store, client.in.data() + pos + sizeof(uint32_t), len, client.may_write, client.out);
+        pos += sizeof(uint32_t) + len;
+    }
+    client.in.erase(0, pos);
+    return true;
+}
+
+// serves and flushes until the socket is full or no complete request is left
+static bool serve_client_io(PropertyStore &store, int fd, serve_client &client, bool readable)
+{
+    if (readable && !read_client(fd, client))
+        return false;
+    for (;;)
+    {
+        size_t buffered = client.in.size();
+        if (!serve_pending(store, client) || !flush_client(fd, client))
+            return false;
+        if (!client.out.empty() || client.in.size() == buffered)
+            return true;
+    }
+}
+
+int run_server(PropertyStore &store, const char *socket_path)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len;
+    if (!make_address(socket_path, &addr, &addr_len))
+    {
+        fprintf(stderr, "invalid socket path [%s]\n", socket_path);
+        return -1;
+    }
+
+    // map everything up front, requests never wait for open()/mmap()
+    for (AreaHandle &area : store)
+    {
+        prop_error err = area.map(false);
+        if (err != PROP_OK && g_verbose_mode)
+            fprintf(stderr, "skip area [%s]: %s\n", area.path().c_str(), prop_strerror(err));
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    if (socket_path[0] != '@')
+        unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, addr_len) < 0 || listen(listen_fd, SOMAXCONN) < 0)
+    {
+        fprintf(stderr, "bind [%s] error:%s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (g_verbose_mode)
+        fprintf(stderr, "serving %zu areas on [%s]\n", store.area_count(), socket_path);
+
+    std::unordered_map<int, serve_client> clients;
+    struct epoll_event events[SERVE_MAX_EVENTS];
+    while (!g_server_stop)
+    {
+        int n = epoll_wait(epoll_fd, events, SERVE_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd)
+            {
+                int client_fd;
+                while ((client_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0)
+                {
+                    ev.events = EPOLLIN;
+                    ev.data.fd = client_fd;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &ev);
+                    clients[client_fd].may_write = peer_may_write(client_fd);
+                }
+                continue;
+            }
+            serve_client &client = clients[fd];
+            bool alive = (events[i].events & (EPOLLERR | EPOLLHUP)) == 0 || (events[i].events & EPOLLIN);
+            if (alive)
+                alive = serve_client_io(store, fd, client, events[i].events & EPOLLIN);
+            if (!alive)
+            {
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+                close(fd);
+                clients.erase(fd);
+                continue;
+            }
+            // while a response is stuck in the buffer, wait for room instead of reading more requests
+            ev.events = client.out.empty() ? EPOLLIN : EPOLLOUT;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+
+    for (auto &client : clients)
+        close(client.first);
+    close(epoll_fd);
+    close(listen_fd);
+    if (socket_path[0] != '@')
+        unlink(socket_path);
+    return 0;
+}
+
+static bool send_request(int fd, uint8_t op, const std::string &payload)
+{
+    std::string frame;
+    size_t start = begin_frame(frame, op);
+    frame.append(payload);
+    end_frame(frame, start);
+    return write_all(fd, frame.data(), frame.size());
+}
+
+static bool recv_response(int fd, uint8_t *status, std::string &payload)
+{
+    char header[sizeof(uint32_t)];
+    if (!read_all(fd, header, sizeof(header)))
+        return false;
+    uint32_t len = get_u32(header);
+    if (len == 0)
+        return false;
+    payload.resize(len);
+    if (!read_all(fd, &payload[0], len))
+        return false;
+    *status = payload[0];
+    payload.erase(0, 1);
+    return true;
+}
+
+int run_client(const char *socket_path, const char *prop_name, uint32_t prop_count)
+{
+    int fd = connect_socket(socket_path);
+    if (fd < 0)
+        return -1;
+
+    std::string pattern = prop_name == NULL ? "**" : prop_name;
+    std::string_view sv(pattern);
+    uint8_t op = SERVE_OP_GET;
+    std::string request;
+    if (prop_count != PROP_COUNT_MAX)
+    {
+        op = SERVE_OP_SET_COUNT;
+        put_u16(request, prop_count);
+    }
+    else if (sv.starts_with("*") || sv.ends_with("*"))
+    {
+        op = SERVE_OP_DUMP;
+    }
+    request.append(pattern);
+
+    uint8_t status;
+    std::string payload;
+    if (!send_request(fd, op, request) || !recv_response(fd, &status, payload))
+    {
+        fprintf(stderr, "lost connection to [%s]\n", socket_path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    if (status != PROP_OK && op != SERVE_OP_SET_COUNT)
+    {
+        if (status != PROP_ERR_NOT_FOUND)
+            fprintf(stderr, "%s!\n", prop_strerror((prop_error)status));
+        return -1;
+    }
+
+    const char *p = payload.data();
+    const char *end = p + payload.size();
+    if (op == SERVE_OP_GET && payload.size() >= sizeof(uint32_t))
+    {
+        prop_content content;
+        content.name = pattern;
+        content.serial = get_u32(p);
+        content.value = std::string_view(p + sizeof(uint32_t), end - p - sizeof(uint32_t));
+        content.output();
+    }
+    else if (op == SERVE_OP_DUMP)
+    {
+        while (end - p >= (ptrdiff_t)(sizeof(uint32_t) + sizeof(uint16_t)))
+        {
+            prop_content content;
+            content.serial = get_u32(p);
+            uint16_t name_len = get_u16(p + sizeof(uint32_t));
+            p += sizeof(uint32_t) + sizeof(uint16_t);
+            if (end - p < name_len + 1 || end - p < name_len + 1 + (uint8_t)p[name_len])
+                break;
+            content.name = std::string_view(p, name_len);
+            uint8_t value_len = p[name_len];
+            content.value = std::string_view(p + name_len + 1, value_len);
+            p += name_len + 1 + value_len;
+            content.output();
+        }
+    }
+    else if (op == SERVE_OP_SET_COUNT && payload.size() >= 2 * sizeof(uint32_t))
+    {
+        print_log("matched %u changed %u\n", get_u32(p), get_u32(p + sizeof(uint32_t)));
+        if (status != PROP_OK)
+        {
+            fprintf(stderr, "%s!\n", prop_strerror((prop_error)status));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_worker(const char *socket_path, const std::vector<std::string> *names, int requests,
+                         int offset, std::vector<uint32_t> *latencies, int *errors)
+{
+    int fd = connect_socket(socket_path);
+    if (fd < 0)
+    {
+        *errors = requests;
+        return;
+    }
+    latencies->reserve(requests);
+    uint8_t status;
+    std::string payload;
+    for (int i = 0; i < requests; i++)
+    {
+        const std::string &name = (*names)[(offset + i) % names->size()];
+        uint64_t start = now_ns();
+        if (!send_request(fd, SERVE_OP_GET, name) || !recv_response(fd, &status, payload))
+        {
+            *errors += requests - i;
+            break;
+        }
+        latencies->push_back(now_ns() - start);
+        if (status != PROP_OK)
+            (*errors)++;
+    }
+    close(fd);
+}
+
+int run_bench(const char *socket_path, const char *pattern, int clients, int requests)
+{
+    // the name set is whatever the server returns for the pattern, so a fixture root decides the mix
+    int fd = connect_socket(socket_path);
+    if (fd < 0)
+        return -1;
+    uint8_t status;
+    std::string payload;
+    if (!send_request(fd, SERVE_OP_DUMP, pattern == NULL ? "**" : pattern) || !recv_response(fd, &status, payload))
+    {
+        fprintf(stderr, "lost connection to [%s]\n", socket_path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    std::vector<std::string> names;
+    for (const char *p = payload.data(), *end = p + payload.size(); end - p >= 6;)
+    {
+        uint16_t name_len = get_u16(p + sizeof(uint32_t));
+        p += sizeof(uint32_t) + sizeof(uint16_t);
+        if (end - p < name_len + 1)
+            break;
+        names.emplace_back(p, name_len);
+        p += name_len + 1 + (uint8_t)p[name_len];
+    }
+    if (names.empty())
+    {
+        fprintf(stderr, "no property matches, nothing to benchmark\n");
+        return -1;
+    }
+    if (clients < 1)
+        clients = 1;
+
+    std::vector<std::vector<uint32_t>> latencies(clients);
+    std::vector<int> errors(clients, 0);
+    std::vector<std::thread> workers;
+    uint64_t start = now_ns();
+    for (int i = 0; i < clients; i++)
+    {
+        int share = requests / clients + (i < requests % clients ? 1 : 0);
+        workers.emplace_back(bench_worker, socket_path, &names, share, i * 7919, &latencies[i], &errors[i]);
+    }
+    for (auto &worker : workers)
+        worker.join();
+    uint64_t elapsed = now_ns() - start;
+
+    std::vector<uint32_t> all;
+    int total_errors = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+        total_errors += errors[i];
+    }
+    if (all.empty())
+    {
+        fprintf(stderr, "no request completed\n");
+        return -1;
+    }
+    std::sort(all.begin(), all.end());
+    uint64_t sum = 0;
+    for (uint32_t v : all)
+        sum += v;
+    print_log("names: %zu clients: %d requests: %zu errors: %d\n", names.size(), clients, all.size(), total_errors);
+    print_log("elapsed: %.3f ms throughput: %.0f req/s\n", elapsed / 1e6, all.size() / (elapsed / 1e9));
+    print_log("latency us: avg %.2f p50 %.2f p99 %.2f max %.2f\n", sum / 1e3 / all.size(),
+              all[all.size() / 2] / 1e3, all[all.size() * 99 / 100] / 1e3, all.back() / 1e3);
+    return total_errors == 0 ? 0 : -1;
+}
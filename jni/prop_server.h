@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "property_store.h"
+
+/**
+ * Framed protocol of the --serve daemon, native byte order (local socket only).
+ *
+ *   request:  u32 length | u8 op     | payload     length counts op + payload
+ *   response: u32 length | u8 status | payload     status is a prop_error
+ *
+ *   SERVE_OP_GET        name                 -> u32 serial | value
+ *   SERVE_OP_DUMP       pattern              -> { u32 serial | u16 name_len | name | u8 value_len | value }*
+ *   SERVE_OP_SET_COUNT  u16 count | pattern  -> u32 matched | u32 changed
+ *
+ * A pattern without a leading or trailing '*' is one exact name. SET_COUNT
+ * is answered with PROP_ERR_PERMISSION unless the peer (SO_PEERCRED) is
+ * root, shell or the daemon's own uid. A client's requests are only read
+ * and served while nothing is left of its earlier responses (or less than
+ * SERVE_OUTPUT_MAX), so a client that doesn't read can't grow the daemon.
+ *
+ * A socket path starting with '@' is bound in the abstract namespace.
+ */
+
+#define SERVE_OP_GET 1
+#define SERVE_OP_DUMP 2
+#define SERVE_OP_SET_COUNT 3
+
+#define SERVE_REQUEST_MAX 4096
+// responses queued for one client before its requests wait
+#define SERVE_OUTPUT_MAX (256 * 1024)
+#define SERVE_SHELL_UID 2000 // AID_SHELL
+
+int run_server(PropertyStore &store, const char *socket_path);
+int run_client(const char *socket_path, const char *prop_name, uint32_t prop_count);
+int run_bench(const char *socket_path, const char *pattern, int clients, int requests);
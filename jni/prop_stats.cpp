@@ -0,0 +1,58 @@
+#include <stdio.h>
+
+#include "prop_stats.h"
+
+prop_stats g_prop_stats = {false, -1, 0, 0, {}, {}, {}};
+
+static const char *const phase_names[PHASE_COUNT] = {"contexts", "map", "traverse", "filter", "output"};
+static const char *const counter_names[COUNTER_COUNT] = {"bytes_mapped", "nodes_visited", "allocations",
+                                                         "serials_written"};
+
+void prop_stats_enable()
+{
+    g_prop_stats.enabled = true;
+    g_prop_stats.start_ns = prop_stats_now();
+}
+
+std::string prop_stats_format(bool json)
+{
+    uint64_t total_ns = g_prop_stats.enabled ? prop_stats_now() - g_prop_stats.start_ns : 0;
+    std::string out;
+    char buffer[128];
+    if (json)
+    {
+        out = "{\"phases\":{";
+        for (int i = 0; i < PHASE_COUNT; i++)
+        {
+            snprintf(buffer, sizeof(buffer), "%s\"%s\":{\"calls\":%llu,\"us\":%.1f}", i == 0 ? "" : ",",
+                     phase_names[i], (unsigned long long) g_prop_stats.phase_calls[i],
+                     g_prop_stats.phase_ns[i] / 1000.0);
+            out += buffer;
+        }
+        out += "},\"counters\":{";
+        for (int i = 0; i < COUNTER_COUNT; i++)
+        {
+            snprintf(buffer, sizeof(buffer), "%s\"%s\":%llu", i == 0 ? "" : ",", counter_names[i],
+                     (unsigned long long) g_prop_stats.counters[i]);
+            out += buffer;
+        }
+        snprintf(buffer, sizeof(buffer), "},\"total_us\":%.1f}\n", total_ns / 1000.0);
+        out += buffer;
+        return out;
+    }
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%-16s %8llu calls %10.3f ms\n", phase_names[i],
+                 (unsigned long long) g_prop_stats.phase_calls[i], g_prop_stats.phase_ns[i] / 1e6);
+        out += buffer;
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%-16s %8llu\n", counter_names[i],
+                 (unsigned long long) g_prop_stats.counters[i]);
+        out += buffer;
+    }
+    snprintf(buffer, sizeof(buffer), "%-16s %25.3f ms\n", "total", total_ns / 1e6);
+    out += buffer;
+    return out;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+/**
+ * Phase timings and counters for one run.
+ *
+ * Counters are plain adds and always on. Phase timers only read the clock
+ * once prop_stats_enable() was called; time is charged to the innermost
+ * running phase, so the phases add up to the time spent inside any of them.
+ * Building with -DPROP_STATS=0 turns every probe into nothing.
+ */
+
+#ifndef PROP_STATS
+#define PROP_STATS 1
+#endif
+
+enum prop_phase
+{
+    PHASE_CONTEXTS,     // property_info / property_contexts loading
+    PHASE_MAP,          // mmap of area files
+    PHASE_TRAVERSE,     // trie lookups and walks
+    PHASE_FILTER,       // wildcard filtering and sorting
+    PHASE_OUTPUT,       // printing results
+    PHASE_COUNT,
+};
+
+enum prop_counter
+{
+    COUNTER_BYTES_MAPPED,
+    COUNTER_NODES_VISITED,
+    COUNTER_ALLOCATIONS,    // prop_bt/prop_info created in areas and context list nodes
+    COUNTER_SERIALS_WRITTEN,
+    COUNTER_COUNT,
+};
+
+struct prop_stats
+{
+    bool enabled;
+    int current;            // innermost running phase, -1 when none
+    uint64_t mark_ns;       // when time was last charged to current
+    uint64_t start_ns;
+    uint64_t phase_ns[PHASE_COUNT];
+    uint64_t phase_calls[PHASE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+};
+
+extern prop_stats g_prop_stats;
+
+static inline uint64_t prop_stats_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void prop_stats_enable();
+// one line of JSON, or a small table
+std::string prop_stats_format(bool json);
+
+class prop_phase_timer
+{
+public:
+    explicit prop_phase_timer(prop_phase phase) : prev_(-1), active_(g_prop_stats.enabled)
+    {
+        if (active_)
+        {
+            uint64_t now = prop_stats_now();
+            if (g_prop_stats.current >= 0)
+            {
+                g_prop_stats.phase_ns[g_prop_stats.current] += now - g_prop_stats.mark_ns;
+            }
+            prev_ = g_prop_stats.current;
+            g_prop_stats.current = phase;
+            g_prop_stats.mark_ns = now;
+            g_prop_stats.phase_calls[phase]++;
+        }
+    }
+    ~prop_phase_timer()
+    {
+        if (active_)
+        {
+            uint64_t now = prop_stats_now();
+            g_prop_stats.phase_ns[g_prop_stats.current] += now - g_prop_stats.mark_ns;
+            g_prop_stats.current = prev_;
+            g_prop_stats.mark_ns = now;
+        }
+    }
+    prop_phase_timer(const prop_phase_timer &) = delete;
+    prop_phase_timer &operator=(const prop_phase_timer &) = delete;
+
+private:
+    int prev_;
+    bool active_;
+};
+
+#if PROP_STATS
+#define PROP_STATS_CONCAT_(a, b) a##b
+#define PROP_STATS_CONCAT(a, b) PROP_STATS_CONCAT_(a, b)
+#define PROP_STATS_PHASE(phase) prop_phase_timer PROP_STATS_CONCAT(phase_timer_, __LINE__)(phase)
+#define PROP_STATS_ADD(counter, n) (g_prop_stats.counters[counter] += (n))
+#else
+#define PROP_STATS_PHASE(phase) do {} while (0)
+#define PROP_STATS_ADD(counter, n) do {} while (0)
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_summary.h"
+
+struct summary_bucket
+{
+    uint32_t props;
+    uint32_t nonzero;
+    uint32_t max_count;
+    uint32_t count_sum;
+    uint32_t long_props;
+    uint32_t mismatch;
+    uint32_t len_hist[SUMMARY_LEN_BUCKETS];
+};
+
+struct summary_mismatch
+{
+    std::string_view name;
+    uint8_t length_byte;
+    uint8_t value_len;
+};
+
+static int len_bucket(size_t len)
+{
+    if (len == 0)
+        return 0;
+    int bucket = 1;
+    for (size_t limit = 8; len >= limit && bucket < SUMMARY_LEN_BUCKETS - 1; limit *= 2)
+        bucket++;
+    return bucket;
+}
+
+static void add_prop(summary_bucket &bucket, uint32_t count, bool is_long, size_t value_len, bool mismatch)
+{
+    bucket.props++;
+    bucket.nonzero += count != 0;
+    bucket.max_count = std::max(bucket.max_count, count);
+    bucket.count_sum += count;
+    bucket.long_props += is_long;
+    bucket.mismatch += mismatch;
+    bucket.len_hist[len_bucket(value_len)]++;
+}
+
+static void append_json_string(std::string &out, std::string_view sv)
+{
+    out += '"';
+    for (char c : sv)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            out += buffer;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static void append_json_bucket(std::string &out, const summary_bucket &b)
+{
+    char buffer[160];
+    snprintf(buffer, sizeof(buffer), "{\"props\":%u,\"nonzero\":%u,\"max_count\":%u,\"count_sum\":%u,\"long\":%u,"
+             "\"mismatch\":%u,\"len\":[", b.props, b.nonzero, b.max_count, b.count_sum, b.long_props, b.mismatch);
+    out += buffer;
+    for (int i = 0; i < SUMMARY_LEN_BUCKETS; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "%s%u", i == 0 ? "" : ",", b.len_hist[i]);
+        out += buffer;
+    }
+    out += "]}";
+}
+
+static void append_json_group(std::string &out, const char *key, const std::map<std::string_view, summary_bucket> &group)
+{
+    out += ",\"";
+    out += key;
+    out += "\":{";
+    bool first = true;
+    for (auto &item : group)
+    {
+        if (!first)
+            out += ',';
+        first = false;
+        append_json_string(out, item.first);
+        out += ':';
+        append_json_bucket(out, item.second);
+    }
+    out += '}';
+}
+
+static void put_bytes(std::string &out, const void *data, size_t len)
+{
+    out.append((const char *)data, len);
+}
+
+static void put_binary_bucket(std::string &out, uint8_t kind, std::string_view name, const summary_bucket &b)
+{
+    uint8_t name_len = name.size() > 255 ? 255 : name.size();
+    put_bytes(out, &kind, 1);
+    put_bytes(out, &name_len, 1);
+    put_bytes(out, name.data(), name_len);
+    put_bytes(out, &b, sizeof(b));
+}
+
+int run_summary(PropertyStore &store, bool binary)
+{
+    summary_bucket total = {};
+    std::map<std::string_view, summary_bucket> contexts;
+    std::map<std::string_view, summary_bucket> prefixes;
+    std::vector<summary_mismatch> mismatched;
+    uint32_t mismatch_count = 0;
+
+    for (AreaHandle &area : store)
+    {
+        prop_error err = area.map(false);
+        if (err != PROP_OK)
+        {
+            report_error(err, &area);
+            continue;
+        }
+        summary_bucket *context_bucket = store.is_split() ? &contexts[area.context()] : NULL;
+        for (PropertyRef ref : area)
+        {
+            uint32_t serial = ref.serial();
+            uint32_t count = serial & PROP_COUNT_MAX;
+            // compat serials use bit 16 for their change counter
+            bool is_long = area.format() == AREA_FORMAT_TRIE && ref.info()->is_long();
+            size_t value_len = strnlen(ref.value(), PROP_VALUE_MAX);
+            bool mismatch = !is_long && (serial >> 24) != value_len;
+            if (mismatch && mismatch_count++ < SUMMARY_MISMATCH_MAX)
+                mismatched.push_back({ref.name(), (uint8_t)(serial >> 24), (uint8_t)value_len});
+
+            std::string_view name(ref.name());
+            std::string_view prefix = name.substr(0, name.find('.'));
+            add_prop(total, count, is_long, value_len, mismatch);
+            add_prop(prefixes[prefix], count, is_long, value_len, mismatch);
+            add_prop(context_bucket != NULL ? *context_bucket : contexts[store.context_of(ref.name())], count,
+                     is_long, value_len, mismatch);
+        }
+    }
+
+    std::string out;
+    if (binary)
+    {
+        uint32_t header[4] = {SUMMARY_MAGIC, (uint32_t)SUMMARY_VERSION | (uint32_t)get_sdk_version() << 16,
+                              (uint32_t)(1 + contexts.size() + prefixes.size()), (uint32_t)mismatched.size()};
+        put_bytes(out, header, sizeof(header));
+        put_binary_bucket(out, 0, "", total);
+        for (auto &item : contexts)
+            put_binary_bucket(out, 1, item.first, item.second);
+        for (auto &item : prefixes)
+            put_binary_bucket(out, 2, item.first, item.second);
+        for (auto &m : mismatched)
+        {
+            uint8_t name_len = m.name.size() > 255 ? 255 : m.name.size();
+            put_bytes(out, &name_len, 1);
+            put_bytes(out, m.name.data(), name_len);
+            put_bytes(out, &m.length_byte, 1);
+            put_bytes(out, &m.value_len, 1);
+        }
+        return fwrite(out.data(), 1, out.size(), stdout) == out.size() ? 0 : -1;
+    }
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "{\"version\":%d,\"sdk\":%d,\"total\":", SUMMARY_VERSION, get_sdk_version());
+    out += buffer;
+    append_json_bucket(out, total);
+    append_json_group(out, "contexts", contexts);
+    append_json_group(out, "prefixes", prefixes);
+    out += ",\"mismatched\":[";
+    for (size_t i = 0; i < mismatched.size(); i++)
+    {
+        out += i == 0 ? "[" : ",[";
+        append_json_string(out, mismatched[i].name);
+        snprintf(buffer, sizeof(buffer), ",%u,%u]", mismatched[i].length_byte, mismatched[i].value_len);
+        out += buffer;
+    }
+    out += "]}\n";
+    // print_log() has a fixed line buffer, the record can be longer
+    fputs(out.c_str(), stdout);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "property_store.h"
+
+/**
+ * --summary: one pass over all areas that prints aggregates instead of
+ * properties, per security context and per first name segment:
+ * property count, nonzero counters, max/summed counter, value length
+ * histogram and properties whose length byte (serial >> 24) disagrees
+ * with strlen(value). Long properties (Android S+) are counted but not
+ * length checked.
+ *
+ * JSON is one line. The binary record uses native byte order:
+ *   u32 magic | u16 version | u16 sdk | u32 buckets | u32 mismatched
+ *   { u8 kind | u8 name_len | name | u32 props | u32 nonzero | u32 max_count
+ *     | u32 count_sum | u32 long_props | u32 mismatch | u32 len_hist[SUMMARY_LEN_BUCKETS] }*
+ *   { u8 name_len | name | u8 length_byte | u8 value_len }*
+ * kind 0 is the whole device, 1 a context, 2 a prefix.
+ */
+
+#define SUMMARY_MAGIC 0x31535053 // "SPS1"
+#define SUMMARY_VERSION 1
+#define SUMMARY_LEN_BUCKETS 6   // value length 0, 1-7, 8-15, 16-31, 32-63, 64-91
+#define SUMMARY_MISMATCH_MAX 64 // listed by name, all of them are counted
+
+int run_summary(PropertyStore &store, bool binary);
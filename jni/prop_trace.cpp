@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "system_properties.h"
+#include "prop_trace.h"
+
+#define RECORD_HEADER_SIZE 18
+
+struct trace_record
+{
+    uint8_t op;
+    uint16_t count;
+    uint64_t start_ns;
+    uint32_t duration_ns;
+    std::string name;
+    std::string value;
+    bool has_value;
+};
+
+struct op_stats
+{
+    std::vector<uint32_t> ns;
+    uint64_t recorded_ns;
+    size_t errors;
+};
+
+static const char *op_names[TRACE_OP_END] = {"?", "get", "set", "dump", "count", "delete"};
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+template <typename T>
+static void put(std::string &out, T v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+template <typename T>
+static T get(const char *p)
+{
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+TraceRecorder::TraceRecorder(const char *path) : path_(path), start_ns_(0), start_mono_ns_(0)
+{
+}
+
+void TraceRecorder::start()
+{
+    start_ns_ = clock_ns(CLOCK_REALTIME);
+    start_mono_ns_ = clock_ns(CLOCK_MONOTONIC);
+}
+
+void TraceRecorder::finish_batch(const std::vector<prop_change> &changes)
+{
+    for (auto &change : changes)
+    {
+        if (change.effective)
+            finish(TRACE_SET, change.name.c_str(), change.has_value ? change.value.c_str() : NULL, change.count);
+    }
+}
+
+void TraceRecorder::finish(trace_op op, const char *name, const char *value, uint32_t count)
+{
+    if (path_ == NULL)
+        return;
+    uint64_t duration = clock_ns(CLOCK_MONOTONIC) - start_mono_ns_;
+    size_t name_len = name == NULL ? 0 : std::min<size_t>(strlen(name), UINT16_MAX);
+    size_t value_len = value == NULL ? 0 : std::min<size_t>(strlen(value), PROP_VALUE_MAX - 1);
+    std::string out;
+    put<uint8_t>(out, op);
+    put<uint8_t>(out, value == NULL ? TRACE_NO_VALUE : value_len);
+    put<uint16_t>(out, name_len);
+    put<uint16_t>(out, count);
+    put<uint64_t>(out, start_ns_);
+    put<uint32_t>(out, std::min<uint64_t>(duration, UINT32_MAX));
+    out.append(name == NULL ? "" : name, name_len);
+    out.append(value == NULL ? "" : value, value_len);
+
+    int fd = open(path_, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "can't record to [%s]: %s\n", path_, strerror(errno));
+        return;
+    }
+    // runs recording at the same time must not both write the file header
+    while (flock(fd, LOCK_EX) < 0 && errno == EINTR)
+        ;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0)
+    {
+        std::string header;
+        put<uint32_t>(header, TRACE_MAGIC);
+        put<uint32_t>(header, TRACE_VERSION);
+        out.insert(0, header);
+    }
+    if (write(fd, out.data(), out.size()) != (ssize_t)out.size())
+        fprintf(stderr, "can't record to [%s]: %s\n", path_, strerror(errno));
+    close(fd);
+}
+
+// false for a missing or foreign file; a cut last record is dropped with a warning
+static bool load_trace(const char *path, std::vector<trace_record> *records)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "can't open trace [%s]: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    const char *data = NULL;
+    size_t size = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            data = (const char *)addr;
+            size = st.st_size;
+        }
+    }
+    close(fd);
+    if (data == NULL || size < 8 || get<uint32_t>(data) != TRACE_MAGIC || get<uint32_t>(data + 4) != TRACE_VERSION)
+    {
+        fprintf(stderr, "[%s] is not a trace file\n", path);
+        if (data != NULL)
+            munmap((void *)data, size);
+        return false;
+    }
+    size_t pos = 8;
+    while (size - pos >= RECORD_HEADER_SIZE)
+    {
+        const char *p = data + pos;
+        trace_record r;
+        r.op = get<uint8_t>(p);
+        uint8_t value_len = get<uint8_t>(p + 1);
+        uint16_t name_len = get<uint16_t>(p + 2);
+        r.count = get<uint16_t>(p + 4);
+        r.start_ns = get<uint64_t>(p + 6);
+        r.duration_ns = get<uint32_t>(p + 14);
+        r.has_value = value_len != TRACE_NO_VALUE;
+        size_t body = name_len + (r.has_value ? value_len : 0);
+        if (size - pos - RECORD_HEADER_SIZE < body || r.op == 0 || r.op >= TRACE_OP_END)
+            break;
+        r.name.assign(p + RECORD_HEADER_SIZE, name_len);
+        r.value.assign(p + RECORD_HEADER_SIZE + name_len, r.has_value ? value_len : 0);
+        records->push_back(std::move(r));
+        pos += RECORD_HEADER_SIZE + body;
+    }
+    if (pos != size)
+        fprintf(stderr, "trace [%s]: %zu bytes at the end aren't a record, ignored\n", path, size - pos);
+    munmap((void *)data, size);
+    return true;
+}
+
+static bool is_wildcard(std::string_view sv)
+{
+    return sv.starts_with("*") || sv.ends_with("*");
+}
+
+// the same library calls the CLI makes for the operation, minus the output
+static bool replay_one(PropertyStore &store, const trace_record &r)
+{
+    const char *name = r.name.c_str();
+    PropertyRef ref;
+    switch (r.op)
+    {
+    case TRACE_GET:
+        return store.get(name, &ref) == PROP_OK && strlen(ref.value()) < PROP_VALUE_MAX;
+    case TRACE_SET:
+    {
+        bool changed;
+        return store.set(name, r.has_value ? r.value.c_str() : NULL, r.count, true, &ref, &changed) == PROP_OK;
+    }
+    case TRACE_DUMP:
+        dump_all(store);
+        filter_all(r.name.empty() ? NULL : name);
+        return true;
+    case TRACE_COUNT:
+    {
+        std::vector<PropertyRef> refs;
+        for (AreaHandle &area : store)
+        {
+            if (area.map(false) != PROP_OK)
+                continue;
+            for (PropertyRef match : area)
+            {
+                if (match_prop_name(r.name, match.name()))
+                    refs.push_back(match);
+            }
+        }
+        std::vector<bool> changed;
+        return store.set_counts(refs, r.count, &changed) == PROP_OK;
+    }
+    case TRACE_DELETE:
+    {
+        if (!is_wildcard(r.name))
+            return store.remove(name) == PROP_OK;
+        dump_all(store);
+        filter_all(name);
+        std::vector<std::string> names;
+        for (auto &p : prop_all)
+            names.emplace_back(p.name);
+        bool ok = true;
+        for (auto &n : names)
+            ok = store.remove(n.c_str()) == PROP_OK && ok;
+        return ok;
+    }
+    }
+    return false;
+}
+
+int run_replay(PropertyStore &store, const char *path, double pace)
+{
+    std::vector<trace_record> records;
+    if (!load_trace(path, &records))
+        return -1;
+    if (records.empty())
+    {
+        fprintf(stderr, "trace [%s] has no records\n", path);
+        return -1;
+    }
+    // runs append as they finish, pacing needs them in start order
+    std::stable_sort(records.begin(), records.end(),
+                     [](const trace_record &a, const trace_record &b) { return a.start_ns < b.start_ns; });
+
+    op_stats stats[TRACE_OP_END] = {};
+    uint64_t first_start = records[0].start_ns;
+    uint64_t replay_start = clock_ns(CLOCK_MONOTONIC);
+    for (auto &r : records)
+    {
+        if (pace > 0)
+        {
+            uint64_t target = replay_start + (uint64_t)((r.start_ns - first_start) / pace);
+            struct timespec ts = {(time_t)(target / 1000000000ull), (long)(target % 1000000000ull)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+        }
+        uint64_t start = clock_ns(CLOCK_MONOTONIC);
+        bool ok = replay_one(store, r);
+        uint64_t elapsed = clock_ns(CLOCK_MONOTONIC) - start;
+        op_stats &s = stats[r.op];
+        s.ns.push_back(std::min<uint64_t>(elapsed, UINT32_MAX));
+        s.recorded_ns += r.duration_ns;
+        s.errors += !ok;
+    }
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC) - replay_start;
+
+    for (int op = TRACE_GET; op < TRACE_OP_END; op++)
+    {
+        op_stats &s = stats[op];
+        size_t n = s.ns.size();
+        if (n == 0)
+            continue;
+        uint64_t sum = 0;
+        for (uint32_t ns : s.ns)
+            sum += ns;
+        std::sort(s.ns.begin(), s.ns.end());
+        print_log("%s: %zu ops %zu failed %.0f ops/s avg %.1f us p50 %.1f p99 %.1f max %.1f, recorded avg %.1f us\n",
+                  op_names[op], n, s.errors, sum == 0 ? 0.0 : n * 1e9 / sum, sum / 1e3 / n, s.ns[n / 2] / 1e3,
+                  s.ns[std::min(n - 1, n * 99 / 100)] / 1e3, s.ns[n - 1] / 1e3, s.recorded_ns / 1e3 / n);
+    }
+    print_log("replayed %zu ops in %.1f ms, %.0f ops/s\n", records.size(), wall / 1e6,
+              records.size() * 1e9 / std::max<uint64_t>(wall, 1));
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "property_store.h"
+#include "prop_transaction.h"
+
+/**
+ * --record FILE: every run appends one record per logical operation it
+ * performs (get, set, wildcard dump, wildcard count, delete) with its
+ * arguments, start time and duration, so a device's real mix of operations
+ * can be replayed later. The duration is the CLI's view, output included.
+ * Batch writes (--create, --import, sets with --journal) append one TRACE_SET
+ * per property they changed, --rollback one TRACE_SET per restored value and
+ * one TRACE_DELETE per property it removed, all with the batch's start time.
+ *
+ * --replay FILE: re-executes the records against --root (never the live
+ * areas; writes change the fixture, so replay a copy) in one process with
+ * the areas kept mapped, without printing. pace 0 runs back to back, 1
+ * keeps the recorded gaps, 2 halves them. Throughput and latency are
+ * reported per operation type next to the recorded durations.
+ *
+ * Native byte order, appended under flock by each run:
+ *   u32 magic | u32 version
+ *   { u8 op | u8 value_len | u16 name_len | u16 count | u64 start_ns | u32 duration_ns | name | value }*
+ * start_ns is CLOCK_REALTIME so records of different runs line up,
+ * value_len TRACE_NO_VALUE means no value, count PROP_COUNT_MAX none.
+ */
+
+#define TRACE_MAGIC 0x31545053 // "SPT1"
+#define TRACE_VERSION 1
+#define TRACE_NO_VALUE 0xFF
+
+enum trace_op
+{
+    TRACE_GET = 1,
+    TRACE_SET,      // value and/or count of one name
+    TRACE_DUMP,     // wildcard (or no name) dump
+    TRACE_COUNT,    // -c with a wildcard
+    TRACE_DELETE,   // name or wildcard
+    TRACE_OP_END,
+};
+
+class TraceRecorder
+{
+public:
+    // NULL records nothing
+    explicit TraceRecorder(const char *path);
+
+    void start();
+    // appends the operation begun at start(); name and value may be NULL
+    void finish(trace_op op, const char *name, const char *value, uint32_t count);
+    // one TRACE_SET per change an applied transaction actually wrote
+    void finish_batch(const std::vector<prop_change> &changes);
+
+private:
+    const char *path_;
+    uint64_t start_ns_;
+    uint64_t start_mono_ns_;
+};
+
+int run_replay(PropertyStore &store, const char *path, double pace);
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "prop_transaction.h"
+
+struct journal_entry
+{
+    uint8_t flags;
+    uint32_t old_serial;
+    std::string name;
+    std::string value;
+};
+
+void PropertyTransaction::add(const char *prop_name, const char *value, uint32_t count, bool create)
+{
+    prop_change change;
+    change.name = prop_name;
+    change.has_value = value != NULL;
+    change.value = value != NULL ? value : "";
+    change.count = count;
+    change.create = create;
+    change.area = nullptr;
+    change.offset = 0;
+    change.old_serial = 0;
+    change.effective = false;
+    changes_.push_back(change);
+    planned_ = false;
+}
+
+prop_error PropertyTransaction::lock_areas()
+{
+    std::vector<AreaHandle *> areas;
+    for (auto &change : changes_)
+    {
+        if (std::find(areas.begin(), areas.end(), change.area) == areas.end())
+        {
+            areas.push_back(change.area);
+        }
+    }
+    // always in path order, so two batches over the same areas can't wait on each other
+    std::sort(areas.begin(), areas.end(), [](AreaHandle *a, AreaHandle *b) { return a->path() < b->path(); });
+    for (AreaHandle *area : areas)
+    {
+        prop_error err = area->lock_write();
+        if (err != PROP_OK)
+        {
+            for (failed_ = 0; changes_[failed_].area != area; failed_++)
+            {
+            }
+            unlock_areas();
+            return err;
+        }
+        locked_.push_back(area);
+    }
+    return PROP_OK;
+}
+
+void PropertyTransaction::unlock_areas()
+{
+    for (auto it = locked_.rbegin(); it != locked_.rend(); ++it)
+    {
+        (*it)->unlock_write();
+    }
+    locked_.clear();
+}
+
+prop_error PropertyTransaction::plan()
+{
+    // new prop_bt paths ("a", "a.b", ...) and names per area, so shared segments count once
+    std::map<AreaHandle *, std::set<std::string>> new_nodes;
+    std::map<AreaHandle *, std::set<std::string>> new_props;
+    std::map<AreaHandle *, area_plan> plans;
+    plans_.clear();
+    planned_ = false;
+    unlock_areas();
+    for (failed_ = 0; failed_ < changes_.size(); failed_++)
+    {
+        prop_change &change = changes_[failed_];
+        if (!prop_name_valid(change.name) || (change.has_value && change.value.size() >= PROP_VALUE_MAX))
+        {
+            return PROP_ERR_INVALID;
+        }
+        prop_error err = store_.area_for(change.name.c_str(), false, &change.area);
+        if (err != PROP_OK)
+        {
+            return err;
+        }
+    }
+    // the old values and the free space below stay valid until apply() because the locks are kept
+    prop_error err = lock_areas();
+    if (err != PROP_OK)
+    {
+        return err;
+    }
+    for (failed_ = 0; failed_ < changes_.size(); failed_++)
+    {
+        prop_change &change = changes_[failed_];
+        PropertyRef ref;
+        err = change.area->find(change.name.c_str(), &ref);
+        if (err == PROP_ERR_NOT_FOUND && change.create)
+        {
+            change.offset = 0;
+            change.old_serial = 0;
+            change.old_value.clear();
+            change.effective = true;
+
+            area_plan &plan = plans[change.area];
+            plan.area = change.area;
+            uint32_t existing = change.area->existing_segments(change.name.c_str());
+            const char *segment = change.name.c_str();
+            for (uint32_t i = 0; segment != NULL; i++)
+            {
+                const char *sep = strchr(segment, '.');
+                size_t len = sep == NULL ? strlen(segment) : sep - segment;
+                if (i >= existing &&
+                    new_nodes[change.area].insert(std::string(change.name.c_str(), segment + len)).second)
+                {
+                    plan.new_nodes++;
+                    plan.bt_bytes += ALIGN(sizeof(prop_bt) + len + 1, sizeof(uint32_t));
+                }
+                segment = sep == NULL ? NULL : sep + 1;
+            }
+            if (new_props[change.area].insert(change.name).second)
+            {
+                plan.new_props++;
+                plan.info_bytes += ALIGN(sizeof(prop_info) + change.name.size() + 1, sizeof(uint32_t));
+            }
+            continue;
+        }
+        if (err != PROP_OK)
+        {
+            unlock_areas();
+            return err;
+        }
+        change.offset = ref.offset();
+        change.old_serial = ref.serial();
+        change.old_value = ref.value();
+        change.effective = (change.has_value && change.value != change.old_value) ||
+                           (change.count != PROP_COUNT_MAX && change.count != ref.count());
+    }
+
+    prop_error result = PROP_OK;
+    for (auto &entry : plans)
+    {
+        area_plan &plan = entry.second;
+        uint32_t used = plan.area->area()->bytes_used;
+        plan.bytes_free = used < AREA_DATA_SIZE ? AREA_DATA_SIZE - used : 0;
+        plans_.push_back(plan);
+        if (!plan.fits() && result == PROP_OK)
+        {
+            for (failed_ = 0; changes_[failed_].area != plan.area || changes_[failed_].offset != 0; failed_++)
+            {
+            }
+            result = PROP_ERR_NO_SPACE;
+        }
+    }
+    planned_ = result == PROP_OK;
+    if (!planned_)
+    {
+        unlock_areas();
+    }
+    return result;
+}
+
+prop_error PropertyTransaction::write_journal(const char *journal_path)
+{
+    if (!planned_)
+    {
+        return PROP_ERR_INVALID;
+    }
+    std::string tmp_path = std::string(journal_path) + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (file == NULL)
+    {
+        return PROP_ERR_OPEN;
+    }
+    uint32_t entries = 0;
+    for (auto &change : changes_)
+    {
+        entries += change.effective;
+    }
+    uint32_t header[3] = {JOURNAL_MAGIC, JOURNAL_VERSION, entries};
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+    for (auto &change : changes_)
+    {
+        if (!change.effective)
+        {
+            continue;
+        }
+        uint8_t flags = change.offset == 0 ? JOURNAL_FLAG_CREATED : 0;
+        uint8_t value_len = change.old_value.size();
+        uint16_t name_len = change.name.size();
+        ok = ok && fwrite(&flags, sizeof(flags), 1, file) == 1 &&
+             fwrite(&value_len, sizeof(value_len), 1, file) == 1 &&
+             fwrite(&name_len, sizeof(name_len), 1, file) == 1 &&
+             fwrite(&change.old_serial, sizeof(change.old_serial), 1, file) == 1 &&
+             fwrite(change.name.data(), name_len, 1, file) == 1 &&
+             (value_len == 0 || fwrite(change.old_value.data(), value_len, 1, file) == 1);
+    }
+    // the journal has to be on disk before the first area is touched
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), journal_path) != 0)
+    {
+        unlink(tmp_path.c_str());
+        return PROP_ERR_OPEN;
+    }
+    return PROP_OK;
+}
+
+prop_error PropertyTransaction::apply(size_t *changed)
+{
+    if (!planned_)
+    {
+        prop_error err = plan();
+        if (err != PROP_OK)
+        {
+            return err;
+        }
+    }
+    prop_error err = apply_planned(changed);
+    unlock_areas();
+    planned_ = false;
+    return err;
+}
+
+prop_error PropertyTransaction::apply_planned(size_t *changed)
+{
+    *changed = 0;
+    // one pass per area, in the order the areas first show up in the batch
+    std::vector<AreaHandle *> areas;
+    for (auto &change : changes_)
+    {
+        if (change.effective && std::find(areas.begin(), areas.end(), change.area) == areas.end())
+        {
+            areas.push_back(change.area);
+        }
+    }
+    for (AreaHandle *area : areas)
+    {
+        // plan() already holds the area's write lock
+        prop_error err = area->map(true);
+        if (err != PROP_OK)
+        {
+            for (failed_ = 0; changes_[failed_].area != area; failed_++)
+            {
+            }
+            return err;
+        }
+        for (failed_ = 0; failed_ < changes_.size(); failed_++)
+        {
+            prop_change &change = changes_[failed_];
+            if (change.area != area || !change.effective)
+            {
+                continue;
+            }
+            PropertyRef ref;
+            if (change.offset != 0)
+            {
+                ref = PropertyRef(area, area->get_prop_info(change.offset), change.offset);
+            }
+            else if ((err = area->add(change.name.c_str(), &ref)) != PROP_OK)
+            {
+                return err;
+            }
+            bool ref_changed = false;
+            err = ref.update(change.has_value ? change.value.c_str() : NULL, change.count, &ref_changed);
+            if (err != PROP_OK)
+            {
+                return err;
+            }
+            *changed += ref_changed || change.offset == 0;
+        }
+    }
+    return PROP_OK;
+}
+
+prop_error PropertyTransaction::rollback(PropertyStore &store, const char *journal_path,
+                                         size_t *restored, size_t *skipped, std::vector<prop_change> *undone)
+{
+    *restored = 0;
+    *skipped = 0;
+    FILE *file = fopen(journal_path, "rb");
+    if (file == NULL)
+    {
+        return PROP_ERR_OPEN;
+    }
+    uint32_t header[3];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != JOURNAL_MAGIC ||
+        header[1] != JOURNAL_VERSION)
+    {
+        fclose(file);
+        return PROP_ERR_INVALID;
+    }
+    // the whole journal is read first, a truncated one restores nothing
+    std::vector<journal_entry> entries;
+    for (uint32_t i = 0; i < header[2]; i++)
+    {
+        journal_entry entry;
+        uint8_t value_len;
+        uint16_t name_len;
+        if (fread(&entry.flags, sizeof(entry.flags), 1, file) != 1 ||
+            fread(&value_len, sizeof(value_len), 1, file) != 1 || fread(&name_len, sizeof(name_len), 1, file) != 1 ||
+            fread(&entry.old_serial, sizeof(entry.old_serial), 1, file) != 1 || value_len >= PROP_VALUE_MAX)
+        {
+            fclose(file);
+            return PROP_ERR_INVALID;
+        }
+        entry.name.assign(name_len, '\0');
+        entry.value.assign(value_len, '\0');
+        if ((name_len != 0 && fread(&entry.name[0], name_len, 1, file) != 1) ||
+            (value_len != 0 && fread(&entry.value[0], value_len, 1, file) != 1))
+        {
+            fclose(file);
+            return PROP_ERR_INVALID;
+        }
+        entries.push_back(entry);
+    }
+    fclose(file);
+
+    // last change first, so a name journaled twice ends up with the value it had before the batch
+    prop_error result = PROP_OK;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+    {
+        AreaHandle *area = nullptr;
+        PropertyRef ref;
+        prop_error err = store.area_for(it->name.c_str(), true, &area);
+        if (err == PROP_OK && (it->flags & JOURNAL_FLAG_CREATED))
+        {
+            // the property didn't exist before, so it goes away again (if nobody deleted it already)
+            err = area->remove(it->name.c_str());
+            err = err == PROP_ERR_NOT_FOUND ? PROP_OK : err;
+        }
+        else if (err == PROP_OK && (err = area->find(it->name.c_str(), &ref)) == PROP_OK)
+        {
+            err = ref.restore(it->old_serial, it->value.c_str());
+        }
+        if (err != PROP_OK)
+        {
+            (*skipped)++;
+            result = err;
+            continue;
+        }
+        (*restored)++;
+        if (undone != nullptr)
+        {
+            prop_change change{};
+            change.name = it->name;
+            change.value = it->value;
+            change.has_value = true;
+            change.count = PROP_COUNT_MAX;
+            change.create = (it->flags & JOURNAL_FLAG_CREATED) != 0;
+            undone->push_back(change);
+        }
+    }
+    return result;
+}
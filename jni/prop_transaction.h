@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "property_store.h"
+
+/**
+ * All-or-nothing batch of property writes.
+ *
+ * plan() resolves every prop_info and works out exactly how many prop_bt and
+ * prop_info bytes the new properties need in each area, counting name
+ * segments shared with existing nodes or with other new names only once.
+ * Nothing is written unless every area has room, and a name that fails
+ * prop_name_valid() or a value that is too long fails the whole batch with
+ * PROP_ERR_INVALID before any lock is taken. plan() takes the write lock
+ * of every area the batch touches, in path order, and they stay held until
+ * apply() returns or the transaction is destroyed, so no other writer of this
+ * tool can use up the space or change an old value in between.
+ *
+ * write_journal() saves the old serial and value of everything that is about
+ * to change, and apply() then maps each area writable once and performs its
+ * changes in a single pass. rollback() replays a journal from the last entry
+ * to the first, restoring old values and deleting the properties the batch
+ * created. With undone it also returns what it did, one prop_change per
+ * property: the restored value, or create set for a property it deleted.
+ *
+ * Journal layout, native byte order:
+ *   u32 magic | u32 version | u32 entries
+ *   { u8 flags | u8 value_len | u16 name_len | u32 old_serial | name | value }*
+ */
+
+#define JOURNAL_MAGIC 0x314A5053 // "SPJ1"
+#define JOURNAL_VERSION 1
+#define JOURNAL_FLAG_CREATED 1
+
+struct prop_change
+{
+    std::string name;
+    std::string value;
+    bool has_value;
+    uint32_t count;
+    bool create;
+
+    // filled by plan()
+    AreaHandle *area;
+    uint32_t offset;        // 0 when the property has to be created
+    uint32_t old_serial;
+    std::string old_value;
+    bool effective;         // false when the property already has the target value/count
+};
+
+/** Space the planned creations take in one area. */
+struct area_plan
+{
+    AreaHandle *area;
+    uint32_t new_nodes;
+    uint32_t bt_bytes;
+    uint32_t new_props;
+    uint32_t info_bytes;
+    uint32_t bytes_free;
+
+    uint32_t need_bytes() const { return bt_bytes + info_bytes; }
+    bool fits() const { return need_bytes() <= bytes_free; }
+};
+
+class PropertyTransaction
+{
+public:
+    explicit PropertyTransaction(PropertyStore &store) : store_(store), planned_(false) {}
+    ~PropertyTransaction() { unlock_areas(); }
+    PropertyTransaction(const PropertyTransaction &) = delete;
+    PropertyTransaction &operator=(const PropertyTransaction &) = delete;
+
+    // value == NULL keeps the value, count == PROP_COUNT_MAX keeps the count
+    void add(const char *prop_name, const char *value, uint32_t count, bool create);
+
+    prop_error plan();
+    prop_error write_journal(const char *journal_path);
+    prop_error apply(size_t *changed);
+
+    const std::vector<prop_change> &changes() const { return changes_; }
+    // one entry per area that gets new properties, filled by plan() even when it fails for space
+    const std::vector<area_plan> &area_plans() const { return plans_; }
+    // index of the change plan()/apply() stopped at
+    size_t failed_index() const { return failed_; }
+
+    static prop_error rollback(PropertyStore &store, const char *journal_path,
+                               size_t *restored, size_t *skipped, std::vector<prop_change> *undone);
+
+private:
+    prop_error lock_areas();
+    void unlock_areas();
+    prop_error apply_planned(size_t *changed);
+
+    PropertyStore &store_;
+    std::vector<prop_change> changes_;
+    std::vector<area_plan> plans_;
+    std::vector<AreaHandle *> locked_;  // held from plan() to the end of apply()
+    bool planned_;
+    size_t failed_;
+};
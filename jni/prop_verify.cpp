@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <dirent.h>
+
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "system_properties.h"
+#include "prop_verify.h"
+#include "prop_clone.h"
+
+int run_verify(PropertyStore &store)
+{
+    size_t props = 0, areas = 0, misplaced = 0, duplicates = 0, missing = 0, unlisted = 0;
+    property_info *info = store.context_info();
+    property_info::batch_resolver resolver(info);
+    std::unordered_map<std::string_view, size_t> seen;
+    std::set<std::string> listed;
+
+    for (size_t i = 0; i < store.area_count(); i++)
+    {
+        AreaHandle &area = store.area_at(i);
+        listed.insert(area.context());
+        prop_error err = area.map(false);
+        if (err == PROP_ERR_OPEN && area.last_errno() == ENOENT)
+        {
+            print_log("missing area for context [%s]\n", area.context().c_str());
+            missing++;
+            continue;
+        }
+        if (err != PROP_OK)
+        {
+            report_error(err, &area);
+            missing++;
+            continue;
+        }
+        areas++;
+        // trie order keeps siblings together, so the resolver mostly reuses its walk
+        for (auto it = area.sorted_begin(); it != area.sorted_end(); ++it)
+        {
+            PropertyRef ref = *it;
+            props++;
+            if (store.is_split())
+            {
+                bool in_place;
+                std::string_view expected;
+                if (info != NULL)
+                {
+                    uint32_t index = resolver.get_context_index(ref.name());
+                    in_place = index == i;
+                    expected = index < store.area_count() ? std::string_view(store.area_at(index).context()) : "";
+                }
+                else
+                {
+                    expected = store.context_of(ref.name());
+                    in_place = expected == area.context();
+                }
+                if (!in_place)
+                {
+                    print_log("misplaced [%s] in [%s] expected [%.*s]\n", ref.name(), area.context().c_str(),
+                              (int)expected.size(), expected.data());
+                    misplaced++;
+                }
+            }
+            auto found = seen.emplace(ref.name(), i);
+            if (!found.second)
+            {
+                print_log("duplicate [%s] in [%s] and [%s]\n", ref.name(),
+                          store.area_at(found.first->second).context().c_str(), area.context().c_str());
+                duplicates++;
+            }
+        }
+    }
+
+    if (store.is_split())
+    {
+        DIR *dir = opendir(store.root().c_str());
+        struct dirent *entry;
+        while (dir != NULL && (entry = readdir(dir)) != NULL)
+        {
+            std::string name(entry->d_name);
+            if (name == "." || name == ".." || name == "property_info" || name == PROP_SERIAL_AREA ||
+                name == PROP_CLONE_MANIFEST || listed.count(name) != 0)
+                continue;
+            if (probe_area_file((store.root() + "/" + name).c_str()) != AREA_FORMAT_UNKNOWN)
+            {
+                print_log("unlisted area [%s]\n", name.c_str());
+                unlisted++;
+            }
+        }
+        if (dir != NULL)
+            closedir(dir);
+    }
+
+    print_log("verified %zu props in %zu areas: misplaced %zu duplicate %zu missing %zu unlisted %zu\n", props, areas,
+              misplaced, duplicates, missing, unlisted);
+    return misplaced + duplicates + missing + unlisted == 0 ? 0 : 1;
+}
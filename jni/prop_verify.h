@@ -0,0 +1,15 @@
+#pragma once
+
+#include "property_store.h"
+
+/**
+ * --verify: cross-checks the areas against the context index. Every
+ * property found is resolved to the context it should live in (in trie
+ * order through property_info::batch_resolver), and reported when it sits
+ * in another area, when the same name is in more than one area, when a
+ * listed context has no area file, or when an area file under the root is
+ * not listed at all. Misplaced properties are invisible to bionic.
+ *
+ * Returns 0 when everything is in place, 1 when problems were found.
+ */
+int run_verify(PropertyStore &store);
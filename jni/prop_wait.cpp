@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "system_properties.h"
+#include "prop_wait.h"
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool condition_holds(PropertyStore &store, const char *prop_name, const char *value, PropertyRef *ref)
+{
+    if (store.get(prop_name, ref) != PROP_OK)
+        return false;
+    return value != NULL ? strcmp(ref->value(), value) == 0 : ref->value()[0] != '\0';
+}
+
+int run_wait(PropertyStore &store, const char *prop_name, const char *value, int timeout_ms)
+{
+    AreaHandle *area = store.serial_area();
+    prop_error err = area != NULL ? area->map(false) : store.area_for(prop_name, false, &area);
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "can't wait for [%s]: %s\n", prop_name, prop_strerror(err));
+        return -1;
+    }
+    const uint32_t *global = &area->area()->serial;
+    int64_t deadline = timeout_ms < 0 ? 0 : now_ns() + timeout_ms * 1000000LL;
+    PropertyRef ref;
+    for (;;)
+    {
+        // serial read before the check: a change in between makes the futex wait return at once
+        const uint32_t *word = store.get(prop_name, &ref) == PROP_OK ? &ref.info()->serial : global;
+        uint32_t serial = load_offset(word);
+        if (condition_holds(store, prop_name, value, &ref))
+        {
+            print_log("[%s]: [%s]\n", ref.name(), ref.value());
+            return 0;
+        }
+        int64_t left = WAIT_RECHECK_MS * 1000000LL;
+        if (timeout_ms >= 0)
+        {
+            int64_t until_deadline = deadline - now_ns();
+            if (until_deadline <= 0)
+            {
+                fprintf(stderr, "timeout waiting for [%s]\n", prop_name);
+                return 1;
+            }
+            left = std::min(left, until_deadline);
+        }
+        struct timespec ts;
+        ts.tv_sec = left / 1000000000LL;
+        ts.tv_nsec = left % 1000000000LL;
+        if (prop_futex_wait(word, serial, &ts) < 0 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+        {
+            fprintf(stderr, "futex wait failed: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "property_store.h"
+
+/**
+ * --wait NAME [VALUE]: blocks until NAME has VALUE (without VALUE: until it
+ * exists with a non-empty value), like bionic's __system_property_wait().
+ *
+ * Nothing is written: once NAME exists the waiter sleeps on a futex on its
+ * prop_info serial, before that on the properties_serial area's serial (the
+ * serial of NAME's own area when the root has none), the words init moves.
+ * Writes by this tool move neither word when a value keeps its length, and
+ * creations don't move the global one, so the condition is also re-checked
+ * every WAIT_RECHECK_MS. timeout_ms < 0 waits forever.
+ *
+ * Returns 0 once the condition holds, 1 on timeout, -1 on error.
+ */
+#define WAIT_RECHECK_MS 100
+
+int run_wait(PropertyStore &store, const char *prop_name, const char *value, int timeout_ms);
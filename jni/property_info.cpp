@@ -1,4 +1,6 @@
 
+#include <stdio.h>
+
 #include "property_info.h"
 
 uint32_t read_u32(uint8_t **pos) {
@@ -11,8 +13,8 @@ bool property_info::is_valid() {
     return property_info_data_ != nullptr;
 }
 
-bool property_info::read_from_file() {
-    int fd = open("/dev/__properties__/property_info", O_RDONLY);
+bool property_info::read_from_file(const char *file_name) {
+    int fd = open(file_name, O_RDONLY);
     if (fd < 0) {
         property_info_data_ = NULL;
         return false;
@@ -23,15 +25,19 @@ bool property_info::read_from_file() {
     property_info_data_ = (uint8_t *) mmap(NULL, property_info_length_, PROT_READ, MAP_PRIVATE, fd, 0);
     close(fd);
     if (property_info_data_ == MAP_FAILED) {
+        property_info_data_ = nullptr;
         return false;
     }
 
-    if (property_info_length_ < sizeof(PropertyInfoAreaHeader)) {
+    PropertyInfoAreaHeader *header = (PropertyInfoAreaHeader *) property_info_data_;
+    // same checks as bionic: newer layouts raise minimum_supported_version, a short file is a bad copy
+    if (property_info_length_ < sizeof(PropertyInfoAreaHeader) ||
+        header->minimum_supported_version > PROPERTY_INFO_VERSION || header->size != property_info_length_) {
+        munmap(property_info_data_, property_info_length_);
+        property_info_data_ = nullptr;
         return false;
     }
 
-    PropertyInfoAreaHeader *header = (PropertyInfoAreaHeader *) property_info_data_;
-
     uint8_t *pos = property_info_data_ + header->contexts_offset;
     uint32_t context_len = read_u32(&pos);
     // printf("context len: %d\n", context_len);
@@ -48,46 +54,50 @@ bool property_info::read_from_file() {
 
     pos = property_info_data_ + header->root_offset;
 
-    root_.init(this, property_info_data_, header->root_offset);
+    root_.init(&arena_, property_info_data_, header->root_offset);
     return true;
 }
 
-property_info::property_info() {
-    if (!read_from_file()) {
+property_info::property_info() : property_info("/dev/__properties__/property_info") {
+}
+
+property_info::property_info(const char *file_name) {
+    if (!read_from_file(file_name)) {
         property_info_data_ = nullptr;
         return;
     }
 }
 
 property_info::~property_info() {
-    munmap(property_info_data_, property_info_length_);
+    if (property_info_data_ != nullptr) {
+        munmap(property_info_data_, property_info_length_);
+    }
 }
 
-std::string property_info::get_context(uint32_t index) {
+std::string_view property_info::get_context(uint32_t index) {
     if (index >= context_offset_.size()) {
         return "";
     } else {
-        return std::string((char *)(property_info_data_ + context_offset_[index]));
+        return std::string_view((char *)(property_info_data_ + context_offset_[index]));
     }
 }
 
-std::string property_info::get_type(uint32_t index) {
+std::string_view property_info::get_type(uint32_t index) {
     if (index >= type_offset_.size()) {
         return "";
     } else {
-        return std::string((char *)(property_info_data_ + type_offset_[index]));
+        return std::string_view((char *)(property_info_data_ + type_offset_[index]));
     }
 }
 
 void property_info::check_prefix_match(const char* remaining_name, property_node& trie_node,
                                 uint32_t* context_index, uint32_t* type_index) {
     const uint32_t remaining_name_size = strlen(remaining_name);
-    for (uint32_t i = 0; i < trie_node.get_prefixes().size(); ++i) {
-        property_entry &entry = trie_node.get_prefixes().at(i);
+    for (property_entry &entry : trie_node.get_prefixes()) {
         auto prefix_len = entry.name.size();
         if (prefix_len > remaining_name_size) continue;
 
-        if (!strncmp(entry.name.c_str(), remaining_name, prefix_len)) {
+        if (!strncmp(entry.name.data(), remaining_name, prefix_len)) {
             if (entry.context_index != ~0u) {
                 *context_index = entry.context_index;
             }
@@ -100,19 +110,23 @@ void property_info::check_prefix_match(const char* remaining_name, property_node
 }
 
 void property_info::print(property_node &node) {
-    printf("current: %s %zu-%zu-%zu\n", node.get_entry().name.c_str(), node.get_prefixes().size(),
+    std::string_view name = node.get_entry().name;
+    printf("current: %.*s %zu-%zu-%zu\n", (int) name.size(), name.data(), node.get_prefixes().size(),
             node.get_exact_matches().size(), node.get_children().size());
     for (uint32_t i = 0; i < node.get_prefixes().size(); i++) {
-        printf("\t - %d prefix: %s\n", i, node.get_prefixes().at(i).name.c_str());
+        name = node.get_prefixes()[i].name;
+        printf("\t - %d prefix: %.*s\n", i, (int) name.size(), name.data());
     }
     for (uint32_t i = 0; i < node.get_exact_matches().size(); i++) {
-        printf("\t - %d exact: %s\n", i, node.get_exact_matches().at(i).name.c_str());
+        name = node.get_exact_matches()[i].name;
+        printf("\t - %d exact: %.*s\n", i, (int) name.size(), name.data());
     }
     for (uint32_t i = 0; i < node.get_children().size(); i++) {
-        printf("\t - %d child: %s\n", i, node.get_children().at(i).get_entry().name.c_str());
+        name = node.get_children()[i].get_entry().name;
+        printf("\t - %d child: %.*s\n", i, (int) name.size(), name.data());
     }
-    for (uint32_t i = 0; i < node.get_children().size(); i++) {
-        print(node.get_children().at(i));
+    for (property_node &child : node.get_children()) {
+        print(child);
     }
 }
 
@@ -120,94 +134,154 @@ void property_info::print() {
     print(root_);
 }
 
-std::string property_info::get_context(const char *property_name) {
+std::string_view property_info::get_context(const char *property_name) {
+    return get_context(get_context_index(property_name));
+}
+
+uint32_t property_info::get_context_index(const char *property_name) {
     uint32_t return_context_index = ~0u;
     uint32_t return_type_index = ~0u;
     const char* remaining_name = property_name;
-    property_node trie_node = root_;
+    property_node *trie_node = &root_;
     while (true) {
         const char* sep = strchr(remaining_name, '.');
 
         // Apply prefix match for prefix deliminated with '.'
-        if (trie_node.get_entry().context_index != ~0u) {
-            return_context_index = trie_node.get_entry().context_index;
+        if (trie_node->get_entry().context_index != ~0u) {
+            return_context_index = trie_node->get_entry().context_index;
         }
 
         // Check prefixes at this node.  This comes after the node check since these prefixes are by
         // definition longer than the node itself.
-        check_prefix_match(remaining_name, trie_node, &return_context_index, &return_type_index);
+        check_prefix_match(remaining_name, *trie_node, &return_context_index, &return_type_index);
 
         if (sep == nullptr) {
           break;
         }
 
-        const uint32_t substr_size = sep - remaining_name;
-        auto children = trie_node.get_children();
-        auto it = children.begin();
-        for (; it != children.end(); it++) {
-            std::string child_name = it->get_entry().name;
-            if (!strncmp(child_name.c_str(), remaining_name, substr_size) && child_name.c_str()[substr_size] == '\0') {
-                trie_node = *it;
+        std::string_view segment(remaining_name, sep - remaining_name);
+        property_node *child = nullptr;
+        for (property_node &node : trie_node->get_children()) {
+            if (node.get_entry().name == segment) {
+                child = &node;
                 break;
             }
         }
-        if (it == children.end()) {
+        if (child == nullptr) {
             break;
         }
+        trie_node = child;
 
         remaining_name = sep + 1;
     }
 
     // We've made it to a leaf node, so check contents and return appropriately.
     // Check exact matches
-    for (uint32_t i = 0; i < trie_node.get_exact_matches().size(); ++i) {
-        if (!strcmp(trie_node.get_exact_matches().at(i).name.c_str(), remaining_name)) {
-            property_entry entry = trie_node.get_exact_matches().at(i);
+    for (property_entry &entry : trie_node->get_exact_matches()) {
+        if (entry.name == remaining_name) {
             if (entry.context_index != ~0u) {
-                return get_context(entry.context_index);
+                return entry.context_index;
             }
         }
     }
 
     // Check prefix matches for prefixes not deliminated with '.'
-    check_prefix_match(remaining_name, trie_node, &return_context_index, &return_type_index);
-    return get_context(return_context_index);
+    check_prefix_match(remaining_name, *trie_node, &return_context_index, &return_type_index);
+    return return_context_index;
+}
+
+uint32_t property_info::batch_resolver::get_context_index(const char *property_name) {
+    if (path_.empty()) {
+        path_.push_back(&info_->root_);
+        offsets_.push_back(0);
+    }
+    const char *last_sep = strrchr(property_name, '.');
+    std::string_view parent(property_name, last_sep == nullptr ? 0 : last_sep - property_name + 1);
+    if (parent != parent_) {
+        // keep the nodes of the leading segments both parents share
+        size_t keep = 1;
+        size_t pos = 0;
+        while (keep < path_.size()) {
+            size_t sep = parent.find('.', pos);
+            if (sep == std::string_view::npos || sep != parent_.find('.', pos) ||
+                parent.substr(pos, sep - pos) != std::string_view(parent_).substr(pos, sep - pos)) {
+                break;
+            }
+            pos = sep + 1;
+            keep++;
+        }
+        path_.resize(keep);
+        offsets_.resize(keep);
+        for (size_t sep; (sep = parent.find('.', pos)) != std::string_view::npos; pos = sep + 1) {
+            std::string_view segment = parent.substr(pos, sep - pos);
+            property_node *child = nullptr;
+            for (property_node &node : path_.back()->get_children()) {
+                if (node.get_entry().name == segment) {
+                    child = &node;
+                    break;
+                }
+            }
+            if (child == nullptr) {
+                break;
+            }
+            path_.push_back(child);
+            offsets_.push_back(sep + 1);
+        }
+        parent_.assign(parent);
+    }
+
+    uint32_t return_context_index = ~0u;
+    uint32_t return_type_index = ~0u;
+    for (size_t i = 0; i < path_.size(); i++) {
+        if (path_[i]->get_entry().context_index != ~0u) {
+            return_context_index = path_[i]->get_entry().context_index;
+        }
+        info_->check_prefix_match(property_name + offsets_[i], *path_[i], &return_context_index, &return_type_index);
+    }
+    const char *remaining_name = property_name + offsets_.back();
+    for (property_entry &entry : path_.back()->get_exact_matches()) {
+        if (entry.name == remaining_name && entry.context_index != ~0u) {
+            return entry.context_index;
+        }
+    }
+    info_->check_prefix_match(remaining_name, *path_.back(), &return_context_index, &return_type_index);
+    return return_context_index;
 }
 
-void property_node::init(property_info *info, uint8_t *begin, uint32_t offset) {
-    info_ = info;
+void property_node::init(PropArena *arena, uint8_t *begin, uint32_t offset) {
     node_ = (TrieNodeInternal *) (begin + offset);
 
     uint8_t *pos = begin + node_->property_entry;
     read_property_entry(entry_, begin, node_->property_entry);
 
     pos = begin + node_->prefix_entries;
-    for (uint32_t i = 0; i < node_->num_prefixes; i++) {
-        uint32_t off = read_u32(&pos);
-        property_entry entry;
-        read_property_entry(entry, begin, off);
-        prefixes_.push_back(entry);
+    num_prefixes_ = node_->num_prefixes;
+    prefixes_ = arena->make_array<property_entry>(num_prefixes_);
+    for (uint32_t i = 0; i < num_prefixes_; i++) {
+        read_property_entry(prefixes_[i], begin, read_u32(&pos));
     }
 
     pos = begin + node_->exact_match_entries;
-    for (uint32_t i = 0; i < node_->num_exact_matches; i++) {
-        uint32_t off = read_u32(&pos);
-        property_entry entry;
-        read_property_entry(entry, begin, off);
-        exact_matches_.push_back(entry);
+    num_exact_matches_ = node_->num_exact_matches;
+    exact_matches_ = arena->make_array<property_entry>(num_exact_matches_);
+    for (uint32_t i = 0; i < num_exact_matches_; i++) {
+        read_property_entry(exact_matches_[i], begin, read_u32(&pos));
     }
 
     pos = begin + node_->child_nodes;
-    for (uint32_t i = 0; i < node_->num_child_nodes; i++) {
-        property_node node;
-        node.init(info, begin, read_u32(&pos));
-        children_.push_back(node);
+    num_children_ = node_->num_child_nodes;
+    children_ = arena->make_array<property_node>(num_children_);
+    for (uint32_t i = 0; i < num_children_; i++) {
+        children_[i].init(arena, begin, read_u32(&pos));
     }
 }
 
 void property_node::read_property_entry(property_entry &entry, uint8_t *begin, uint32_t offset) {
     uint8_t *pos = begin + offset;
-    entry.name = std::string((char *)(begin + read_u32(&pos)), read_u32(&pos));
+    // argument evaluation order is unspecified, read offset and length separately
+    uint32_t name_offset = read_u32(&pos);
+    uint32_t name_length = read_u32(&pos);
+    entry.name = std::string_view((char *)(begin + name_offset), name_length);
     entry.context_index = read_u32(&pos);
     entry.type_index = read_u32(&pos);
 }
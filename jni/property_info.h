@@ -1,6 +1,8 @@
 #pragma once
 
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <string.h>
@@ -9,8 +11,13 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 
+#include "prop_arena.h"
+
 class property_info;
 
+// the only property_info layout so far (Android O and later)
+#define PROPERTY_INFO_VERSION 1
+
 // Copy from AOSP
 struct PropertyInfoAreaHeader {
   // The current version of this data as created by property service.
@@ -23,6 +30,17 @@ struct PropertyInfoAreaHeader {
   uint32_t root_offset;
 };
 
+// Copy from AOSP
+struct PropertyEntry {
+  uint32_t name_offset;
+  uint32_t namelen;
+
+  // This is the context match for this node_; ~0u if it doesn't correspond to any.
+  uint32_t context_index;
+  // This is the type for this node_; ~0u if it doesn't correspond to any.
+  uint32_t type_index;
+};
+
 // Copy from AOSP
 struct TrieNodeInternal {
   // This points to a property entry struct, which includes the name for this node
@@ -43,49 +61,73 @@ struct TrieNodeInternal {
 };
 
 struct property_entry {
-    std::string name;
-    int context_index;
-    int type_index;
+    std::string_view name;      // points into the mapped file
+    uint32_t context_index;
+    uint32_t type_index;
 };
 
 uint32_t read_u32(uint8_t **pos);
 
+/** Decoded trie node; the arrays live in the owning property_info's arena. */
 class property_node {
     public:
-        void init(property_info *info, uint8_t *begin, uint32_t offset);
-        void read_property_entry(property_entry &entry, uint8_t *begin, uint32_t offset);
+        void init(PropArena *arena, uint8_t *begin, uint32_t offset);
+        static void read_property_entry(property_entry &entry, uint8_t *begin, uint32_t offset);
 
         property_entry &get_entry() { return entry_; }
-        std::vector<property_entry> &get_prefixes() { return prefixes_; }
-        std::vector<property_entry> &get_exact_matches() { return exact_matches_; }
-        std::vector<property_node> &get_children() { return children_; }
-
-    private:
-        TrieNodeInternal *node_;
-        property_entry entry_;
-        std::vector<property_node> children_;
-        std::vector<property_entry> prefixes_;
-        std::vector<property_entry> exact_matches_;
+        std::span<property_entry> get_prefixes() { return {prefixes_, num_prefixes_}; }
+        std::span<property_entry> get_exact_matches() { return {exact_matches_, num_exact_matches_}; }
+        std::span<property_node> get_children() { return {children_, num_children_}; }
 
     private:
-        property_info *info_;
+        TrieNodeInternal *node_ = nullptr;
+        property_entry entry_ = {};
+        property_node *children_ = nullptr;
+        uint32_t num_children_ = 0;
+        property_entry *prefixes_ = nullptr;
+        uint32_t num_prefixes_ = 0;
+        property_entry *exact_matches_ = nullptr;
+        uint32_t num_exact_matches_ = 0;
 };
 
 class property_info {
     public:
         property_info();
+        explicit property_info(const char *file_name);
         ~property_info();
 
         uint32_t get_context_size() { return context_offset_.size(); }
-        std::string get_context(uint32_t index);
-        std::string get_type(uint32_t index);
-        std::string get_context(const char *property_name);
+        uint32_t get_type_size() { return type_offset_.size(); }
+        property_node &get_root() { return root_; }
+        // views into the mapped file, NUL terminated, empty when out of range
+        std::string_view get_context(uint32_t index);
+        std::string_view get_type(uint32_t index);
+        std::string_view get_context(const char *property_name);
+        uint32_t get_context_index(const char *property_name);
+
+        /**
+         * Same answers as get_context_index(), for many names in a row: the trie
+         * nodes of the previous name's parent segments are kept, so names that
+         * come in trie order mostly skip the walk and only redo the prefix checks.
+         */
+        class batch_resolver {
+            public:
+                explicit batch_resolver(property_info *info) : info_(info) {}
+                uint32_t get_context_index(const char *property_name);
+
+            private:
+                property_info *info_;
+                std::string parent_;                // "a.b." of the previous name
+                std::vector<property_node *> path_; // nodes walked for parent_, root first
+                std::vector<uint32_t> offsets_;     // where each node's remaining name starts
+        };
+
         void print();
         void print(property_node &node);
         bool is_valid();
 
     private:
-        bool read_from_file();
+        bool read_from_file(const char *file_name);
         void check_prefix_match(const char* remaining_name, property_node& trie_node,
                                 uint32_t* context_index, uint32_t* type_index);
 
@@ -94,6 +136,7 @@ class property_info {
         uint32_t property_info_length_;
         std::vector<uint32_t> context_offset_;
         std::vector<uint32_t> type_offset_;
+        PropArena arena_;
         property_node root_;
 };
 
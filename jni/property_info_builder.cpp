@@ -0,0 +1,545 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+
+#include <algorithm>
+
+#include "property_info.h"
+#include "property_info_builder.h"
+
+#define INFO_ALIGN(x) (((x) + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1))
+
+// https://cs.android.com/android/platform/superproject/main/+/main:system/core/property_service/libpropertyinfoserializer/property_info_file.cpp
+static bool is_type_valid(const std::vector<std::string_view> &words)
+{
+    static const char *const valid_types[] = {"string", "bool", "int", "uint", "double", "size"};
+    if (words[0] == "enum")
+    {
+        return words.size() > 1;
+    }
+    if (words.size() > 1)
+    {
+        return false;
+    }
+    for (const char *type : valid_types)
+    {
+        if (words[0] == type)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_property_info_line(std::string_view line, property_info_rule *out, std::string *error)
+{
+    std::vector<std::string_view> words;
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        while (pos < line.size() && isspace((unsigned char) line[pos]))
+        {
+            pos++;
+        }
+        size_t start = pos;
+        while (pos < line.size() && !isspace((unsigned char) line[pos]))
+        {
+            pos++;
+        }
+        if (pos > start)
+        {
+            words.push_back(line.substr(start, pos - start));
+        }
+    }
+    if (words.empty())
+    {
+        *error = "Did not find a property entry in '" + std::string(line) + "'";
+        return false;
+    }
+    if (words.size() < 2)
+    {
+        *error = "Did not find a context entry in '" + std::string(line) + "'";
+        return false;
+    }
+    out->name = words[0];
+    out->context = words[1];
+    out->exact = false;
+    out->type.clear();
+    if (words.size() > 2)
+    {
+        if (words[2] == "exact")
+        {
+            out->exact = true;
+        }
+        else if (words[2] != "prefix")
+        {
+            *error = "Match operation '" + std::string(words[2]) + "' is not valid: must be either 'prefix' or 'exact'";
+            return false;
+        }
+    }
+    if (words.size() > 3)
+    {
+        std::vector<std::string_view> type_words(words.begin() + 3, words.end());
+        if (!is_type_valid(type_words))
+        {
+            *error = "Type '" + std::string(type_words[0]) + "' is not valid";
+            return false;
+        }
+        for (std::string_view word : type_words)
+        {
+            if (!out->type.empty())
+            {
+                out->type += ' ';
+            }
+            out->type += word;
+        }
+    }
+    return true;
+}
+
+/**
+ * The image being written, as offsets into one growing buffer (TrieNodeArena):
+ * every allocation is zeroed and rounded up to 4 bytes, and nothing holds a
+ * pointer across an allocation.
+ */
+struct info_image
+{
+    std::string data;
+    // sorted like the tables written, for the indexes in PropertyEntry
+    std::vector<std::string_view> contexts;
+    std::vector<std::string_view> types;
+
+    uint32_t alloc(size_t size)
+    {
+        uint32_t offset = data.size();
+        data.resize(offset + INFO_ALIGN(size), '\0');
+        return offset;
+    }
+    uint32_t &u32(uint32_t offset) { return *(uint32_t *) &data[offset]; }
+    template <typename T> T *at(uint32_t offset) { return (T *) &data[offset]; }
+
+    uint32_t add_string(std::string_view s)
+    {
+        uint32_t offset = alloc(s.size() + 1);
+        memcpy(&data[offset], s.data(), s.size());
+        return offset;
+    }
+
+    // count, offset array, then the strings in order
+    void add_strings(const std::set<std::string> &strings, std::vector<std::string_view> *table)
+    {
+        u32(alloc(sizeof(uint32_t))) = strings.size();
+        uint32_t array = alloc(strings.size() * sizeof(uint32_t));
+        uint32_t i = 0;
+        for (const std::string &s : strings)
+        {
+            u32(array + i++ * sizeof(uint32_t)) = add_string(s);
+            table->push_back(s);
+        }
+    }
+
+    static uint32_t index_of(const std::vector<std::string_view> &table, const std::string *s)
+    {
+        if (s == nullptr || s->empty())
+        {
+            return ~0u;
+        }
+        auto it = std::lower_bound(table.begin(), table.end(), std::string_view(*s));
+        return it != table.end() && *it == *s ? it - table.begin() : ~0u;
+    }
+
+    // the entry first, then its name
+    uint32_t add_entry(const std::string &name, const std::string *context, const std::string *type)
+    {
+        uint32_t offset = alloc(sizeof(PropertyEntry));
+        uint32_t name_offset = add_string(name);
+        PropertyEntry *entry = at<PropertyEntry>(offset);
+        entry->name_offset = name_offset;
+        entry->namelen = name.size();
+        entry->context_index = index_of(contexts, context);
+        entry->type_index = index_of(types, type);
+        return offset;
+    }
+};
+
+PropertyInfoBuilder::node *PropertyInfoBuilder::node::find_child(std::string_view child_name)
+{
+    for (node &child : children)
+    {
+        if (child.name == child_name)
+        {
+            return &child;
+        }
+    }
+    return nullptr;
+}
+
+bool PropertyInfoBuilder::node::empty() const
+{
+    return context == nullptr && type == nullptr && prefixes.empty() && exact_matches.empty() && children.empty();
+}
+
+void PropertyInfoBuilder::node::prune()
+{
+    for (node &child : children)
+    {
+        child.prune();
+    }
+    std::erase_if(children, [](const node &child) { return child.empty(); });
+}
+
+size_t PropertyInfoBuilder::node::count() const
+{
+    size_t n = 1;
+    for (const node &child : children)
+    {
+        n += child.count();
+    }
+    return n;
+}
+
+PropertyInfoBuilder::PropertyInfoBuilder(const char *default_context, const char *default_type)
+{
+    root_.name = "root";
+    root_.context = intern(contexts_, default_context);
+    root_.type = intern(types_, default_type);
+}
+
+// StringPointerFromContainer(): each string is kept, and written, once
+const std::string *PropertyInfoBuilder::intern(std::set<std::string> &strings, std::string_view s)
+{
+    return &*strings.emplace(s).first;
+}
+
+size_t PropertyInfoBuilder::node_count() const
+{
+    return root_.count();
+}
+
+void PropertyInfoBuilder::load_node(property_info &info, property_node &in, node &out)
+{
+    auto context_of = [&](uint32_t index) {
+        return index == ~0u ? nullptr : intern(contexts_, info.get_context(index));
+    };
+    auto type_of = [&](uint32_t index) {
+        return index == ~0u ? nullptr : intern(types_, info.get_type(index));
+    };
+    out.name = in.get_entry().name;
+    out.context = context_of(in.get_entry().context_index);
+    out.type = type_of(in.get_entry().type_index);
+    for (property_entry &e : in.get_prefixes())
+    {
+        out.prefixes.push_back({std::string(e.name), context_of(e.context_index), type_of(e.type_index)});
+    }
+    for (property_entry &e : in.get_exact_matches())
+    {
+        out.exact_matches.push_back({std::string(e.name), context_of(e.context_index), type_of(e.type_index)});
+    }
+    out.children.resize(in.get_children().size());
+    for (size_t i = 0; i < out.children.size(); i++)
+    {
+        load_node(info, in.get_children()[i], out.children[i]);
+    }
+}
+
+prop_error PropertyInfoBuilder::load(const char *path)
+{
+    property_info info(path);
+    if (!info.is_valid())
+    {
+        return access(path, R_OK) != 0 ? PROP_ERR_OPEN : PROP_ERR_BAD_VERSION;
+    }
+    contexts_.clear();
+    types_.clear();
+    root_ = node();
+    // listed strings nothing points to still take their place in the tables
+    for (uint32_t i = 0; i < info.get_context_size(); i++)
+    {
+        intern(contexts_, info.get_context(i));
+    }
+    for (uint32_t i = 0; i < info.get_type_size(); i++)
+    {
+        intern(types_, info.get_type(i));
+    }
+    load_node(info, info.get_root(), root_);
+    return PROP_OK;
+}
+
+prop_error PropertyInfoBuilder::load_contexts(const char *path, std::vector<std::string> *errors)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return PROP_ERR_OPEN;
+    }
+    char *buffer = NULL;
+    size_t len = 0;
+    ssize_t n;
+    size_t line_no = 0;
+    while ((n = getline(&buffer, &len, file)) > 0)
+    {
+        line_no++;
+        std::string_view line(buffer, n);
+        while (!line.empty() && isspace((unsigned char) line.front()))
+        {
+            line.remove_prefix(1);
+        }
+        while (!line.empty() && isspace((unsigned char) line.back()))
+        {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+        property_info_rule rule;
+        std::string error;
+        if (!parse_property_info_line(line, &rule, &error) || !add(rule, false, &error))
+        {
+            errors->push_back(std::string(path) + ":" + std::to_string(line_no) + ": " + error);
+        }
+    }
+    free(buffer);
+    fclose(file);
+    return PROP_OK;
+}
+
+// TrieBuilder::AddToTrie(): the segments before the last are nodes, created on the way
+bool PropertyInfoBuilder::add(const property_info_rule &rule, bool replace, std::string *error)
+{
+    if (rule.name.empty() || rule.context.empty())
+    {
+        *error = "Empty name or context in rule for '" + rule.name + "'";
+        return false;
+    }
+    const std::string *context = intern(contexts_, rule.context);
+    const std::string *type = intern(types_, rule.type);
+
+    std::string_view name = rule.name;
+    bool ends_with_dot = name.back() == '.';
+    if (ends_with_dot)
+    {
+        name.remove_suffix(1);
+    }
+    node *current = &root_;
+    size_t pos = 0;
+    for (size_t sep; (sep = name.find('.', pos)) != std::string_view::npos; pos = sep + 1)
+    {
+        std::string_view segment = name.substr(pos, sep - pos);
+        node *child = current->find_child(segment);
+        if (child == nullptr)
+        {
+            current->children.push_back(node());
+            child = &current->children.back();
+            child->name = segment;
+        }
+        current = child;
+    }
+    std::string_view last = name.substr(pos);
+
+    if (rule.exact || !ends_with_dot)
+    {
+        std::vector<entry> &entries = rule.exact ? current->exact_matches : current->prefixes;
+        for (entry &e : entries)
+        {
+            if (e.name == last)
+            {
+                if (!replace)
+                {
+                    *error = std::string("Duplicate ") + (rule.exact ? "exact" : "prefix") + " match detected for '" +
+                             rule.name + "'";
+                    return false;
+                }
+                e.context = context;
+                e.type = type;
+                return true;
+            }
+        }
+        entries.push_back({std::string(last), context, type});
+        return true;
+    }
+
+    node *child = current->find_child(last);
+    if (child == nullptr)
+    {
+        current->children.push_back(node());
+        child = &current->children.back();
+        child->name = last;
+    }
+    if ((child->context != nullptr || child->type != nullptr) && !replace)
+    {
+        *error = "Duplicate prefix match detected for '" + rule.name + "'";
+        return false;
+    }
+    child->context = context;
+    child->type = type;
+    return true;
+}
+
+bool PropertyInfoBuilder::remove(std::string_view name)
+{
+    if (name.empty())
+    {
+        return false;
+    }
+    bool ends_with_dot = name.back() == '.';
+    if (ends_with_dot)
+    {
+        name.remove_suffix(1);
+    }
+    node *current = &root_;
+    size_t pos = 0;
+    for (size_t sep; (sep = name.find('.', pos)) != std::string_view::npos; pos = sep + 1)
+    {
+        current = current->find_child(name.substr(pos, sep - pos));
+        if (current == nullptr)
+        {
+            return false;
+        }
+    }
+    std::string_view last = name.substr(pos);
+    bool removed = false;
+    if (ends_with_dot)
+    {
+        node *child = current->find_child(last);
+        if (child != nullptr && (child->context != nullptr || child->type != nullptr))
+        {
+            child->context = nullptr;
+            child->type = nullptr;
+            removed = true;
+        }
+    }
+    else
+    {
+        removed = std::erase_if(current->prefixes, [&](const entry &e) { return e.name == last; }) +
+                  std::erase_if(current->exact_matches, [&](const entry &e) { return e.name == last; }) > 0;
+    }
+    if (removed)
+    {
+        root_.prune();
+    }
+    return removed;
+}
+
+// TrieSerializer::WriteTrieNode(): node, its entry, prefixes, exact matches, then the children
+uint32_t PropertyInfoBuilder::write_node(info_image &image, const node &n) const
+{
+    uint32_t offset = image.alloc(sizeof(TrieNodeInternal));
+    uint32_t entry = image.add_entry(n.name, n.context, n.type);
+    image.at<TrieNodeInternal>(offset)->property_entry = entry;
+
+    // longest first: lookups take the first prefix that matches
+    std::vector<const PropertyInfoBuilder::entry *> prefixes;
+    for (const PropertyInfoBuilder::entry &e : n.prefixes)
+    {
+        prefixes.push_back(&e);
+    }
+    std::stable_sort(prefixes.begin(), prefixes.end(),
+                     [](auto *lhs, auto *rhs) { return lhs->name.size() > rhs->name.size(); });
+    uint32_t array = image.alloc(prefixes.size() * sizeof(uint32_t));
+    image.at<TrieNodeInternal>(offset)->num_prefixes = prefixes.size();
+    image.at<TrieNodeInternal>(offset)->prefix_entries = array;
+    for (size_t i = 0; i < prefixes.size(); i++)
+    {
+        uint32_t e = image.add_entry(prefixes[i]->name, prefixes[i]->context, prefixes[i]->type);
+        image.u32(array + i * sizeof(uint32_t)) = e;
+    }
+
+    std::vector<const PropertyInfoBuilder::entry *> exact_matches;
+    for (const PropertyInfoBuilder::entry &e : n.exact_matches)
+    {
+        exact_matches.push_back(&e);
+    }
+    std::sort(exact_matches.begin(), exact_matches.end(), [](auto *lhs, auto *rhs) { return lhs->name < rhs->name; });
+    array = image.alloc(exact_matches.size() * sizeof(uint32_t));
+    image.at<TrieNodeInternal>(offset)->num_exact_matches = exact_matches.size();
+    image.at<TrieNodeInternal>(offset)->exact_match_entries = array;
+    for (size_t i = 0; i < exact_matches.size(); i++)
+    {
+        uint32_t e = image.add_entry(exact_matches[i]->name, exact_matches[i]->context, exact_matches[i]->type);
+        image.u32(array + i * sizeof(uint32_t)) = e;
+    }
+
+    std::vector<const node *> children;
+    for (const node &child : n.children)
+    {
+        children.push_back(&child);
+    }
+    std::sort(children.begin(), children.end(), [](auto *lhs, auto *rhs) { return lhs->name < rhs->name; });
+    array = image.alloc(children.size() * sizeof(uint32_t));
+    image.at<TrieNodeInternal>(offset)->num_child_nodes = children.size();
+    image.at<TrieNodeInternal>(offset)->child_nodes = array;
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        uint32_t child = write_node(image, *children[i]);
+        image.u32(array + i * sizeof(uint32_t)) = child;
+    }
+    return offset;
+}
+
+std::string PropertyInfoBuilder::serialize() const
+{
+    info_image image;
+    uint32_t header = image.alloc(sizeof(PropertyInfoAreaHeader));
+    image.at<PropertyInfoAreaHeader>(header)->current_version = PROPERTY_INFO_VERSION;
+    image.at<PropertyInfoAreaHeader>(header)->minimum_supported_version = PROPERTY_INFO_VERSION;
+
+    image.at<PropertyInfoAreaHeader>(header)->contexts_offset = image.data.size();
+    image.add_strings(contexts_, &image.contexts);
+    image.at<PropertyInfoAreaHeader>(header)->types_offset = image.data.size();
+    image.add_strings(types_, &image.types);
+
+    uint32_t root = write_node(image, root_);
+    image.at<PropertyInfoAreaHeader>(header)->root_offset = root;
+    image.at<PropertyInfoAreaHeader>(header)->size = image.data.size();
+    return std::move(image.data);
+}
+
+// same steps as PersistentPropertyFile::write_file(), read-only like the file init writes
+prop_error PropertyInfoBuilder::write(const char *path) const
+{
+    std::string content = serialize();
+    std::string tmp_path = std::string(path) + ".tmp";
+    unlink(tmp_path.c_str());
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+    if (fd < 0)
+    {
+        return PROP_ERR_OPEN;
+    }
+    const char *p = content.data();
+    size_t left = content.size();
+    while (left > 0)
+    {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+    bool ok = left == 0 && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path) != 0)
+    {
+        unlink(tmp_path.c_str());
+        return PROP_ERR_OPEN;
+    }
+    std::string dir = path;
+    int dir_fd = ::open(dirname(&dir[0]), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return PROP_OK;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "property_store.h"
+
+class property_info;
+class property_node;
+struct info_image;
+
+// what init passes to BuildTrie() for the root node
+#define PROPERTY_INFO_DEFAULT_CONTEXT "u:object_r:default_prop:s0"
+#define PROPERTY_INFO_DEFAULT_TYPE "string"
+
+/** One property_contexts line: "name context [exact|prefix] [type...]". */
+struct property_info_rule
+{
+    std::string name;       // a trailing '.' gives the context to the whole node
+    std::string context;
+    std::string type;       // words joined by one space, empty when not given
+    bool exact;
+};
+
+// ParsePropertyInfoLine() the way init calls it, false with *error set for a malformed line
+bool parse_property_info_line(std::string_view line, property_info_rule *out, std::string *error);
+
+/**
+ * Offline counterpart of AOSP's property_info_serializer (TrieBuilder +
+ * TrieSerializer): takes property_contexts rules, or the trie of an existing
+ * property_info image, and writes the image the lookup code reads. Children
+ * and exact matches come out sorted by name, prefixes longest first, and
+ * contexts/types as sorted string tables; every block is 4-byte aligned and
+ * laid out in the same order as the AOSP serializer, so the same rules give
+ * the same bytes.
+ */
+class PropertyInfoBuilder
+{
+public:
+    explicit PropertyInfoBuilder(const char *default_context = PROPERTY_INFO_DEFAULT_CONTEXT,
+                                 const char *default_type = PROPERTY_INFO_DEFAULT_TYPE);
+
+    /**
+     * Starts over from the image at path: its nodes, entries, root defaults
+     * and every context/type it lists, used or not, so writing it back
+     * unchanged gives the same bytes.
+     */
+    prop_error load(const char *path);
+    /**
+     * Adds the rules of a property_contexts file, like init does for each
+     * of its files in turn. Malformed lines and duplicates are appended to
+     * errors as "path:line: message" and skipped.
+     */
+    prop_error load_contexts(const char *path, std::vector<std::string> *errors);
+
+    // false with *error on a duplicate of an earlier rule, unless replace
+    bool add(const property_info_rule &rule, bool replace, std::string *error);
+    // drops the prefix and exact rules for name ("a.b." the node's own), false when there was none
+    bool remove(std::string_view name);
+
+    std::string serialize() const;
+    // temp file + rename, the file is replaced whole or not at all
+    prop_error write(const char *path) const;
+
+    size_t context_count() const { return contexts_.size(); }
+    size_t type_count() const { return types_.size(); }
+    size_t node_count() const;
+
+private:
+    struct entry
+    {
+        std::string name;
+        const std::string *context;     // into contexts_/types_, NULL when unset
+        const std::string *type;
+    };
+    struct node
+    {
+        std::string name;
+        const std::string *context = nullptr;
+        const std::string *type = nullptr;
+        std::vector<entry> prefixes;
+        std::vector<entry> exact_matches;
+        std::vector<node> children;
+
+        node *find_child(std::string_view child_name);
+        bool empty() const;
+        // drops the children left without a context or entries, at any depth
+        void prune();
+        size_t count() const;
+    };
+
+    const std::string *intern(std::set<std::string> &strings, std::string_view s);
+    void load_node(property_info &info, property_node &in, node &out);
+    uint32_t write_node(info_image &image, const node &n) const;
+
+private:
+    std::set<std::string> contexts_;
+    std::set<std::string> types_;
+    node root_;
+};
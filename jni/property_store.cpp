@@ -0,0 +1,1544 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <algorithm>
+
+#include <sys/system_properties.h>
+
+#include "property_store.h"
+#include "prop_stats.h"
+#include "prop_audit.h"
+
+const char *prop_strerror(prop_error err)
+{
+    switch (err)
+    {
+    case PROP_OK: return "success";
+    case PROP_ERR_NOT_FOUND: return "property not found";
+    case PROP_ERR_NO_CONTEXT: return "can't find security context file";
+    case PROP_ERR_OPEN: return "can't open area file";
+    case PROP_ERR_BAD_AREA: return "not a property area";
+    case PROP_ERR_MAP: return "map failed";
+    case PROP_ERR_READ_ONLY: return "area is mapped read-only";
+    case PROP_ERR_NO_SPACE: return "no enough space in area";
+    case PROP_ERR_INVALID: return "invalid property name or value";
+    case PROP_ERR_LOCK: return "can't lock area for writing";
+    case PROP_ERR_BAD_VERSION: return "unsupported area format";
+    case PROP_ERR_CORRUPT: return "area offset out of range";
+    case PROP_ERR_PERMISSION: return "permission denied";
+    }
+    return "unknown error";
+}
+
+bool prop_name_valid(std::string_view name)
+{
+    return !name.empty() && name.front() != '.' && name.back() != '.' && name.find("..") == std::string_view::npos;
+}
+
+int get_sdk_version()
+{
+    static int sdk_version = 0;
+    if (sdk_version != 0)
+    {
+        return sdk_version;
+    }
+    char sdk_value[PROP_VALUE_MAX] = {0};
+    __system_property_get("ro.build.version.sdk", sdk_value);
+    if (strlen(sdk_value) > 0)
+    {
+        sdk_version = atoi(sdk_value);
+    }
+    return sdk_version;
+}
+
+static int cmp_prop_name(const char *one, uint8_t one_len, const char *two, uint8_t two_len)
+{
+    if (one_len < two_len)
+        return -1;
+    else if (one_len > two_len)
+        return 1;
+    else
+        return strncmp(one, two, one_len);
+}
+
+int prop_trie_cmp(const char *one, size_t one_len, const char *two, size_t two_len)
+{
+    const char *one_end = one + one_len;
+    const char *two_end = two + two_len;
+    while (one < one_end && two < two_end)
+    {
+        const char *one_sep = (const char *) memchr(one, '.', one_end - one);
+        const char *two_sep = (const char *) memchr(two, '.', two_end - two);
+        size_t one_seg = (one_sep != NULL ? one_sep : one_end) - one;
+        size_t two_seg = (two_sep != NULL ? two_sep : two_end) - two;
+        if (one_seg != two_seg)
+        {
+            return one_seg < two_seg ? -1 : 1;
+        }
+        int ret = memcmp(one, two, one_seg);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        one += one_seg + (one_sep != NULL);
+        two += two_seg + (two_sep != NULL);
+    }
+    return (one < one_end) - (two < two_end);
+}
+
+prop_error PropertyRef::update(const char *value, uint32_t count, bool *changed)
+{
+    if (value != NULL && strlen(value) >= PROP_VALUE_MAX)
+    {
+        return PROP_ERR_INVALID;
+    }
+    // a no-op never needs the area writable
+    if (!info_->needs_update(value, count))
+    {
+        if (changed != NULL)
+        {
+            *changed = false;
+        }
+        return PROP_OK;
+    }
+    if (!area_->is_writable())
+    {
+        return PROP_ERR_READ_ONLY;
+    }
+    AreaWriteLock lock(area_);
+    if (lock.error() != PROP_OK)
+    {
+        return lock.error();
+    }
+    PropAuditLog *audit = area_->audit();
+    char old_value[PROP_VALUE_MAX];
+    uint32_t old_serial = info_->get_serial();
+    if (audit != nullptr)
+    {
+        memcpy(old_value, info_->value, sizeof(old_value));
+    }
+    bool result = info_->update_value_count(value, count);
+    PROP_STATS_ADD(COUNTER_SERIALS_WRITTEN, result);
+    if (result)
+    {
+        prop_futex_wake(&info_->serial);
+        if (audit != nullptr)
+        {
+            audit->record(AUDIT_SET, name_, old_value, old_serial, info_->value, info_->get_serial());
+        }
+    }
+    if (changed != NULL)
+    {
+        *changed = result;
+    }
+    return PROP_OK;
+}
+
+prop_error PropertyRef::restore(uint32_t serial, const char *value)
+{
+    if (!area_->is_writable())
+    {
+        return PROP_ERR_READ_ONLY;
+    }
+    if (strlen(value) >= PROP_VALUE_MAX)
+    {
+        return PROP_ERR_INVALID;
+    }
+    AreaWriteLock lock(area_);
+    if (lock.error() != PROP_OK)
+    {
+        return lock.error();
+    }
+    PropAuditLog *audit = area_->audit();
+    char old_value[PROP_VALUE_MAX];
+    uint32_t old_serial = info_->get_serial();
+    if (audit != nullptr)
+    {
+        memcpy(old_value, info_->value, sizeof(old_value));
+    }
+    strncpy(info_->value, value, sizeof(info_->value));
+    __atomic_store_n(&info_->serial, serial, __ATOMIC_RELEASE);
+    PROP_STATS_ADD(COUNTER_SERIALS_WRITTEN, 1);
+    prop_futex_wake(&info_->serial);
+    if (audit != nullptr)
+    {
+        audit->record(AUDIT_RESTORE, name_, old_value, old_serial, info_->value, serial);
+    }
+    return PROP_OK;
+}
+
+prop_area_format probe_area_file(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return AREA_FORMAT_UNKNOWN;
+    }
+    struct stat st;
+    prop_area header;
+    prop_area_format format = AREA_FORMAT_UNKNOWN;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && pread(fd, &header, sizeof(header), 0) == sizeof(header))
+    {
+        format = get_area_format(&header, st.st_size);
+    }
+    close(fd);
+    return format;
+}
+
+int prop_futex_wait(const uint32_t *word, uint32_t expected, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout, NULL, 0) == 0 ? 0 : -1;
+}
+
+void prop_futex_wake(uint32_t *word)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+AreaHandle::AreaHandle(const std::string &path, const std::string &context)
+    : path_(path), context_(context), area_(nullptr), size_(0), format_(AREA_FORMAT_UNKNOWN), writable_(false),
+      errno_(0), lock_fd_(-1), lock_depth_(0), reuse_free_(false), audit_(nullptr)
+{
+}
+
+AreaHandle::AreaHandle(AreaHandle &&other) noexcept
+    : path_(std::move(other.path_)), context_(std::move(other.context_)), area_(other.area_), size_(other.size_),
+      format_(other.format_), writable_(other.writable_), errno_(other.errno_), lock_fd_(other.lock_fd_), lock_depth_(other.lock_depth_),
+      reuse_free_(other.reuse_free_), index_(std::move(other.index_)), audit_(other.audit_)
+{
+    other.area_ = nullptr;
+    other.writable_ = false;
+    other.lock_fd_ = -1;
+    other.lock_depth_ = 0;
+}
+
+AreaHandle &AreaHandle::operator=(AreaHandle &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        if (lock_fd_ >= 0)
+        {
+            close(lock_fd_);
+        }
+        path_ = std::move(other.path_);
+        context_ = std::move(other.context_);
+        area_ = other.area_;
+        size_ = other.size_;
+        format_ = other.format_;
+        writable_ = other.writable_;
+        errno_ = other.errno_;
+        lock_fd_ = other.lock_fd_;
+        lock_depth_ = other.lock_depth_;
+        reuse_free_ = other.reuse_free_;
+        index_ = std::move(other.index_);
+        audit_ = other.audit_;
+        other.area_ = nullptr;
+        other.writable_ = false;
+        other.lock_fd_ = -1;
+        other.lock_depth_ = 0;
+    }
+    return *this;
+}
+
+AreaHandle::~AreaHandle()
+{
+    unmap();
+    if (lock_fd_ >= 0)
+    {
+        close(lock_fd_);
+    }
+}
+
+prop_error AreaHandle::lock_write()
+{
+    if (lock_depth_ > 0)
+    {
+        lock_depth_++;
+        return PROP_OK;
+    }
+    if (lock_fd_ < 0)
+    {
+        // a write lock needs a writable fd; nothing is created next to the area
+        lock_fd_ = open(path_.c_str(), O_RDWR | O_CLOEXEC);
+        if (lock_fd_ < 0)
+        {
+            errno_ = errno;
+            return PROP_ERR_LOCK;
+        }
+    }
+    // whole file, owned by the open file description: closing other fds of the area keeps it
+    struct flock lock = {};
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    int ret;
+    while ((ret = fcntl(lock_fd_, F_OFD_SETLKW, &lock)) < 0 && errno == EINTR)
+    {
+    }
+    if (ret < 0)
+    {
+        errno_ = errno;
+        return PROP_ERR_LOCK;
+    }
+    lock_depth_ = 1;
+    return PROP_OK;
+}
+
+void AreaHandle::unlock_write()
+{
+    if (lock_depth_ > 0 && --lock_depth_ == 0)
+    {
+        struct flock lock = {};
+        lock.l_type = F_UNLCK;
+        lock.l_whence = SEEK_SET;
+        fcntl(lock_fd_, F_OFD_SETLK, &lock);
+    }
+}
+
+prop_error AreaHandle::map(bool writable)
+{
+    if (area_ != nullptr && (writable_ || !writable))
+    {
+        return PROP_OK;
+    }
+    PROP_STATS_PHASE(PHASE_MAP);
+    int fd = open(path_.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd == -1)
+    {
+        errno_ = errno;
+        return PROP_ERR_OPEN;
+    }
+    struct stat fd_stat;
+    if (fstat(fd, &fd_stat) < 0)
+    {
+        errno_ = errno;
+        close(fd);
+        return PROP_ERR_OPEN;
+    }
+    // the header decides the layout before anything is mapped
+    prop_area header;
+    if (fd_stat.st_size < (off_t) sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != PROP_AREA_MAGIC)
+    {
+        close(fd);
+        return PROP_ERR_BAD_AREA;
+    }
+    prop_area_format format = get_area_format(&header, fd_stat.st_size);
+    if (format == AREA_FORMAT_UNKNOWN)
+    {
+        close(fd);
+        return PROP_ERR_BAD_VERSION;
+    }
+    if (writable && format != AREA_FORMAT_TRIE)
+    {
+        close(fd);
+        return PROP_ERR_READ_ONLY;
+    }
+    // a read-only mapping is replaced in place, so pointers into the area stay valid
+    size_ = fd_stat.st_size;
+    format_ = format;
+    void *addr = mmap(area_, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      area_ != nullptr ? MAP_SHARED | MAP_FIXED : MAP_SHARED, fd, 0);
+    errno_ = errno;
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        // a failed MAP_FIXED may have dropped the old mapping already
+        area_ = nullptr;
+        writable_ = false;
+        return PROP_ERR_MAP;
+    }
+    area_ = (prop_area *) addr;
+    writable_ = writable;
+    PROP_STATS_ADD(COUNTER_BYTES_MAPPED, size_);
+    return PROP_OK;
+}
+
+void AreaHandle::unmap()
+{
+    if (area_ != nullptr)
+    {
+        munmap(area_, size_);
+        area_ = nullptr;
+        writable_ = false;
+        index_ = name_index();
+    }
+}
+
+prop_bt *AreaHandle::get_prop_bt(uint32_t off) const
+{
+    if (off > AREA_DATA_SIZE)
+    {
+        return NULL;
+    }
+    return (prop_bt *) (area_->data + off);
+}
+
+prop_info *AreaHandle::get_prop_info(uint32_t off) const
+{
+    if (off > AREA_DATA_SIZE)
+    {
+        return NULL;
+    }
+    return (prop_info *) (area_->data + off);
+}
+
+// callers hold the write lock
+bool AreaHandle::alloc_obj(uint32_t size, uint32_t *off)
+{
+    uint32_t *link = &area_->reserved[AREA_FREE_LIST];
+    for (uint32_t cur = reuse_free_ ? *link : 0; cur != 0 && cur <= AREA_DATA_SIZE - sizeof(prop_free); cur = *link)
+    {
+        prop_free *block = (prop_free *) (area_->data + cur);
+        if (block->size >= size)
+        {
+            // a remainder too small to hold a prop_free stays with the new object
+            uint32_t rest = block->size - size;
+            if (rest >= sizeof(prop_free))
+            {
+                prop_free *tail = (prop_free *) (area_->data + cur + size);
+                tail->next = block->next;
+                tail->size = rest;
+                *link = cur + size;
+            }
+            else
+            {
+                *link = block->next;
+            }
+            *off = cur;
+            return true;
+        }
+        link = &block->next;
+    }
+    uint32_t new_off = area_->bytes_used;
+    if (new_off + size > AREA_DATA_SIZE)
+    {
+        return false;
+    }
+    publish_offset(&area_->bytes_used, new_off + size);
+    *off = new_off;
+    return true;
+}
+
+// the list is kept in offset order so neighbours merge and a block at the end gives its bytes back
+void AreaHandle::free_obj(uint32_t off, uint32_t size)
+{
+    // without reuse the bytes stay as they are, for readers still holding a pointer into them
+    if (!reuse_free_)
+    {
+        return;
+    }
+    uint32_t *prev_link = NULL;
+    uint32_t *link = &area_->reserved[AREA_FREE_LIST];
+    while (*link != 0 && *link < off && *link <= AREA_DATA_SIZE - sizeof(prop_free))
+    {
+        prev_link = link;
+        link = &((prop_free *) (area_->data + *link))->next;
+    }
+    uint32_t next = *link;
+    if (next != 0 && off + size == next)
+    {
+        prop_free *after = (prop_free *) (area_->data + next);
+        size += after->size;
+        next = after->next;
+    }
+    if (prev_link != NULL && *prev_link + ((prop_free *) (area_->data + *prev_link))->size == off)
+    {
+        link = prev_link;
+        off = *prev_link;
+        size += ((prop_free *) (area_->data + off))->size;
+    }
+    if (off + size == area_->bytes_used)
+    {
+        *link = next;
+        publish_offset(&area_->bytes_used, off);
+        return;
+    }
+    prop_free *block = (prop_free *) (area_->data + off);
+    block->next = next;
+    block->size = size;
+    *link = off;
+}
+
+// callers hold the write lock; the node is filled in before *off makes it reachable
+prop_bt *AreaHandle::new_prop_bt(const char *name, uint8_t namelen, uint32_t *off)
+{
+    uint32_t need_size = ALIGN(sizeof(prop_bt) + namelen + 1, sizeof(uint32_t));
+    uint32_t new_off;
+    if (!alloc_obj(need_size, &new_off))
+    {
+        return NULL;
+    }
+    prop_bt *bt = (prop_bt *) (area_->data + new_off);
+    PROP_STATS_ADD(COUNTER_ALLOCATIONS, 1);
+    memset(bt, 0, sizeof(prop_bt));
+    bt->namelen = namelen;
+    memcpy(bt->name, name, namelen);
+    bt->name[namelen] = '\0';
+    publish_offset(off, new_off);
+    return bt;
+}
+
+prop_info *AreaHandle::new_prop_info(const char *prop_name, uint8_t namelen, uint32_t *off)
+{
+    uint32_t need_size = ALIGN(sizeof(prop_info) + namelen + 1, sizeof(uint32_t));
+    uint32_t new_off;
+    if (!alloc_obj(need_size, &new_off))
+    {
+        return NULL;
+    }
+    prop_info *info = (prop_info *) (area_->data + new_off);
+    PROP_STATS_ADD(COUNTER_ALLOCATIONS, 1);
+    memset(info, 0, sizeof(prop_info));
+    memcpy(info->name, prop_name, namelen);
+    info->name[namelen] = '\0';
+    publish_offset(off, new_off);
+    return info;
+}
+
+static uint32_t hash_name(const char *name)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++)
+    {
+        hash = (hash ^ (uint8_t) *name) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t AreaHandle::compat_count() const
+{
+    return std::min<uint32_t>(load_offset(&area_->bytes_used), (size_ - COMPAT_TOC_OFFSET) / sizeof(uint32_t));
+}
+
+PropertyRef AreaHandle::compat_ref(uint32_t i)
+{
+    const uint32_t *toc = (const uint32_t *) ((const char *) area_ + COMPAT_TOC_OFFSET);
+    uint32_t off = COMPAT_TOC_INFO(toc[i]);
+    if (off < COMPAT_TOC_OFFSET || off > size_ - sizeof(prop_info_compat))
+    {
+        return PropertyRef();
+    }
+    prop_info_compat *info = (prop_info_compat *) ((char *) area_ + off);
+    return PropertyRef(this, (prop_info *) &info->serial, info->name, off);
+}
+
+// bionic's __system_property_find_compat: a linear scan, the toc carries the name length
+prop_error AreaHandle::find_compat(const char *prop_name, PropertyRef *out)
+{
+    size_t len = strlen(prop_name);
+    if (len >= PROP_NAME_MAX)
+    {
+        return PROP_ERR_NOT_FOUND;
+    }
+    const uint32_t *toc = (const uint32_t *) ((const char *) area_ + COMPAT_TOC_OFFSET);
+    for (uint32_t i = 0, count = compat_count(); i < count; i++)
+    {
+        PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+        if (COMPAT_TOC_NAME_LEN(toc[i]) != len)
+        {
+            continue;
+        }
+        PropertyRef ref = compat_ref(i);
+        if (ref.is_valid() && memcmp(ref.name(), prop_name, len) == 0)
+        {
+            *out = ref;
+            return PROP_OK;
+        }
+    }
+    return PROP_ERR_NOT_FOUND;
+}
+
+prop_error AreaHandle::find(const char *prop_name, PropertyRef *out)
+{
+    if (area_ != nullptr && format_ == AREA_FORMAT_COMPAT && prop_name != NULL)
+    {
+        return find_compat(prop_name, out);
+    }
+    if (area_ == nullptr || prop_name == NULL || *prop_name == '\0' || ++index_.lookups <= INDEX_MIN_LOOKUPS)
+    {
+        return find_prop_info(prop_name, false, out);
+    }
+    if (!index_is_fresh())
+    {
+        build_index();
+    }
+    uint32_t hash = hash_name(prop_name);
+    uint32_t mask = index_.offsets.size() - 1;
+    for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        uint32_t off = index_.offsets[slot];
+        if (off == 0)
+        {
+            return PROP_ERR_NOT_FOUND;
+        }
+        if (index_.hashes[slot] == hash)
+        {
+            prop_info *info = get_prop_info(off);
+            if (strcmp(info->name, prop_name) == 0)
+            {
+                // deleted since the build: bytes_used stays, only the prop_bt lets go of it
+                prop_bt *node = get_prop_bt(index_.nodes[slot]);
+                if (node == NULL || load_offset(&node->prop) != off)
+                {
+                    index_.built = false;
+                    return find_prop_info(prop_name, false, out);
+                }
+                *out = PropertyRef(this, info, off);
+                return PROP_OK;
+            }
+        }
+    }
+}
+
+uint64_t AreaHandle::content_hash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    if (area_ == nullptr)
+    {
+        return hash;
+    }
+    // the entry count and the toc right behind the header words, or bytes_used and the data in use
+    hash = (hash ^ load_offset(&area_->bytes_used)) * 1099511628211ULL;
+    const char *p = (const char *) area_ + COMPAT_TOC_OFFSET;
+    size_t len = size_ - COMPAT_TOC_OFFSET;
+    if (format_ != AREA_FORMAT_COMPAT)
+    {
+        p = area_->data;
+        len = std::min<size_t>(load_offset(&area_->bytes_used), size_ - sizeof(prop_area));
+    }
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; i < len; i++)
+    {
+        hash = (hash ^ (uint8_t) p[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// adds move bytes_used, deletes and reuse move the free list head
+bool AreaHandle::index_is_fresh() const
+{
+    return index_.built && index_.bytes_used == load_offset(&area_->bytes_used) &&
+           index_.free_list == load_offset(&area_->reserved[AREA_FREE_LIST]);
+}
+
+void AreaHandle::build_index()
+{
+    // header read before the walk: a property added meanwhile makes the index stale again, not wrong
+    index_.bytes_used = load_offset(&area_->bytes_used);
+    index_.free_list = load_offset(&area_->reserved[AREA_FREE_LIST]);
+    // every prop_info takes more than sizeof(prop_info) bytes, so this bounds the load factor by 1/2
+    size_t capacity = 16;
+    while (capacity < 2 * (index_.bytes_used / sizeof(prop_info) + 1))
+    {
+        capacity *= 2;
+    }
+    index_.offsets.assign(capacity, 0);
+    index_.hashes.assign(capacity, 0);
+    index_.nodes.assign(capacity, 0);
+    for (iterator it = begin(); it != end(); ++it)
+    {
+        index_insert(hash_name((*it).name()), (*it).offset(), it.node_offset());
+    }
+    index_.built = true;
+}
+
+void AreaHandle::index_insert(uint32_t hash, uint32_t off, uint32_t node)
+{
+    uint32_t mask = index_.offsets.size() - 1;
+    uint32_t slot = hash & mask;
+    while (index_.offsets[slot] != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index_.offsets[slot] = off;
+    index_.hashes[slot] = hash;
+    index_.nodes[slot] = node;
+}
+
+prop_error AreaHandle::add(const char *prop_name, PropertyRef *out)
+{
+    if (!writable_)
+    {
+        return PROP_ERR_READ_ONLY;
+    }
+    AreaWriteLock lock(this);
+    if (lock.error() != PROP_OK)
+    {
+        return lock.error();
+    }
+    // under the lock nobody else moves bytes_used, so our own creation can go straight into a fresh index
+    bool fresh = index_is_fresh();
+    // a creation out of the free list leaves bytes_used alone, so it has to be reported
+    bool created = false;
+    uint32_t node = 0;
+    prop_error err = find_prop_info(prop_name, true, out, &created, &node);
+    if (fresh && err == PROP_OK && created)
+    {
+        index_.bytes_used = area_->bytes_used;
+        index_.free_list = area_->reserved[AREA_FREE_LIST];
+        if (index_.offsets.size() < 2 * (index_.bytes_used / sizeof(prop_info) + 1))
+        {
+            index_.built = false;
+        }
+        else
+        {
+            index_insert(hash_name(prop_name), out->offset(), node);
+        }
+    }
+    if (err == PROP_OK && created && audit_ != nullptr)
+    {
+        audit_->record(AUDIT_CREATE, prop_name, NULL, 0, out->value(), out->serial());
+    }
+    return err;
+}
+
+prop_error AreaHandle::remove(const char *prop_name)
+{
+    if (!writable_)
+    {
+        return PROP_ERR_READ_ONLY;
+    }
+    if (prop_name == NULL || *prop_name == '\0')
+    {
+        return PROP_ERR_INVALID;
+    }
+    AreaWriteLock lock(this);
+    if (lock.error() != PROP_OK)
+    {
+        return lock.error();
+    }
+    // per name segment: the node and the word linking it in (parent's children or a sibling's left/right)
+    struct step
+    {
+        uint32_t *link;
+        uint32_t off;
+    };
+    std::vector<step> path;
+    prop_bt *parent = get_prop_bt(0);
+    const char *remain_name = prop_name;
+    while (true)
+    {
+        const char *seq = strchr(remain_name, '.');
+        uint8_t substr_size = seq != NULL ? (seq - remain_name) : strlen(remain_name);
+        uint32_t *link = &parent->children;
+        uint32_t off = load_offset(link);
+        prop_bt *p_bt = NULL;
+        while (off != 0)
+        {
+            if ((p_bt = get_prop_bt(off)) == NULL)
+            {
+                return PROP_ERR_CORRUPT;
+            }
+            int ret = cmp_prop_name(remain_name, substr_size, p_bt->name, p_bt->namelen);
+            if (ret == 0)
+            {
+                break;
+            }
+            link = ret < 0 ? &p_bt->left : &p_bt->right;
+            off = load_offset(link);
+        }
+        if (off == 0)
+        {
+            return PROP_ERR_NOT_FOUND;
+        }
+        path.push_back({link, off});
+        if (seq == NULL)
+        {
+            break;
+        }
+        parent = p_bt;
+        remain_name = seq + 1;
+    }
+
+    prop_bt *leaf = get_prop_bt(path.back().off);
+    uint32_t prop = load_offset(&leaf->prop);
+    prop_info *info = prop == 0 ? NULL : get_prop_info(prop);
+    if (info == NULL)
+    {
+        return PROP_ERR_NOT_FOUND;
+    }
+    if (audit_ != nullptr)
+    {
+        audit_->record(AUDIT_DELETE, prop_name, info->value, info->get_serial(), NULL, 0);
+    }
+    publish_offset(&leaf->prop, 0);
+    free_obj(prop, ALIGN(sizeof(prop_info) + strlen(info->name) + 1, sizeof(uint32_t)));
+    for (size_t i = path.size(); i-- > 0;)
+    {
+        prop_bt *p_bt = get_prop_bt(path[i].off);
+        if (load_offset(&p_bt->prop) != 0 || load_offset(&p_bt->children) != 0)
+        {
+            break;
+        }
+        uint32_t size = ALIGN(sizeof(prop_bt) + p_bt->namelen + 1, sizeof(uint32_t));
+        unlink_bt(path[i].link, path[i].off);
+        free_obj(path[i].off, size);
+    }
+    // offsets went away, unlike a value change
+    index_.built = false;
+    return PROP_OK;
+}
+
+void AreaHandle::unlink_bt(uint32_t *link, uint32_t off)
+{
+    prop_bt *p_bt = get_prop_bt(off);
+    uint32_t left = load_offset(&p_bt->left);
+    uint32_t right = load_offset(&p_bt->right);
+    if (left == 0 || right == 0)
+    {
+        publish_offset(link, left != 0 ? left : right);
+        return;
+    }
+    // the smallest node of the right subtree takes the node's place
+    uint32_t *succ_link = &p_bt->right;
+    uint32_t succ = right;
+    prop_bt *s_bt = get_prop_bt(succ);
+    uint32_t next;
+    while ((next = load_offset(&s_bt->left)) != 0)
+    {
+        succ_link = &s_bt->left;
+        succ = next;
+        s_bt = get_prop_bt(succ);
+    }
+    if (succ != right)
+    {
+        publish_offset(succ_link, load_offset(&s_bt->right));
+        publish_offset(&s_bt->right, right);
+    }
+    publish_offset(&s_bt->left, left);
+    publish_offset(link, succ);
+}
+
+uint32_t AreaHandle::existing_segments(const char *prop_name) const
+{
+    uint32_t segments = 0;
+    prop_bt *p_bt = get_prop_bt(0);
+    const char *remain_name = prop_name;
+    uint32_t children;
+    while (p_bt != NULL && (children = load_offset(&p_bt->children)) != 0)
+    {
+        const char *seq = strchr(remain_name, '.');
+        uint8_t substr_size = seq != NULL ? (seq - remain_name) : strlen(remain_name);
+        p_bt = get_prop_bt(children);
+        while (p_bt != NULL)
+        {
+            PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+            int ret = cmp_prop_name(remain_name, substr_size, p_bt->name, p_bt->namelen);
+            if (ret == 0)
+            {
+                break;
+            }
+            uint32_t next = ret < 0 ? load_offset(&p_bt->left) : load_offset(&p_bt->right);
+            p_bt = next == 0 ? NULL : get_prop_bt(next);
+        }
+        if (p_bt == NULL)
+        {
+            break;
+        }
+        segments++;
+        if (seq == NULL)
+        {
+            break;
+        }
+        remain_name = seq + 1;
+    }
+    return segments;
+}
+
+prop_bt *AreaHandle::find_prefix(const char *prefix, uint32_t *nodes) const
+{
+    if (area_ == nullptr || format_ != AREA_FORMAT_TRIE)
+    {
+        return NULL;
+    }
+    prop_bt *p_bt = get_prop_bt(0);
+    const char *remain_name = prefix;
+    while (p_bt != NULL && *remain_name != '\0')
+    {
+        const char *seq = strchr(remain_name, '.');
+        size_t substr_size = seq != NULL ? (seq - remain_name) : strlen(remain_name);
+        uint32_t children = load_offset(&p_bt->children);
+        p_bt = children == 0 ? NULL : get_prop_bt(children);
+        while (p_bt != NULL)
+        {
+            (*nodes)++;
+            PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+            int ret = cmp_prop_name(remain_name, substr_size, p_bt->name, p_bt->namelen);
+            if (ret == 0)
+            {
+                break;
+            }
+            uint32_t next = ret < 0 ? load_offset(&p_bt->left) : load_offset(&p_bt->right);
+            p_bt = next == 0 ? NULL : get_prop_bt(next);
+        }
+        if (seq == NULL)
+        {
+            break;
+        }
+        remain_name = seq + 1;
+    }
+    return p_bt;
+}
+
+prop_error AreaHandle::find_prop_info(const char *prop_name, bool need_add, PropertyRef *out, bool *created,
+                                      uint32_t *node)
+{
+    if (area_ == nullptr)
+    {
+        return PROP_ERR_MAP;
+    }
+    if (prop_name == NULL || strlen(prop_name) == 0)
+    {
+        return PROP_ERR_INVALID;
+    }
+    PROP_STATS_PHASE(PHASE_TRAVERSE);
+    prop_bt *prev_bt = get_prop_bt(0);
+    uint32_t children = load_offset(&prev_bt->children);
+    prop_bt *p_bt = children == 0 ? NULL : get_prop_bt(children);
+    const char *remain_name = prop_name;
+    while (true)
+    {
+        const char *seq = strchr(remain_name, '.');
+        bool want_subtree = (seq != NULL);
+        uint8_t substr_size = want_subtree ? (seq - remain_name) : strlen(remain_name);
+
+        if (p_bt == NULL)
+        {
+            if (!need_add)
+            {
+                return PROP_ERR_NOT_FOUND;
+            }
+            p_bt = new_prop_bt(remain_name, substr_size, &prev_bt->children);
+            if (p_bt == NULL)
+            {
+                return PROP_ERR_NO_SPACE;
+            }
+        }
+
+        prop_bt *current = NULL;
+        while (p_bt != NULL)
+        {
+            PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+            int ret = cmp_prop_name(remain_name, substr_size, p_bt->name, p_bt->namelen);
+            if (ret == 0)
+            {
+                current = p_bt;
+                break;
+            }
+            uint32_t *next = ret < 0 ? &p_bt->left : &p_bt->right;
+            uint32_t next_off = load_offset(next);
+            if (next_off != 0)
+            {
+                p_bt = get_prop_bt(next_off);
+                if (p_bt == NULL)
+                {
+                    return PROP_ERR_CORRUPT;
+                }
+            }
+            else if (need_add)
+            {
+                p_bt = new_prop_bt(remain_name, substr_size, next);
+                if (p_bt == NULL)
+                {
+                    return PROP_ERR_NO_SPACE;
+                }
+            }
+            else
+            {
+                return PROP_ERR_NOT_FOUND;
+            }
+        }
+
+        if (!want_subtree)
+        {
+            uint32_t prop = load_offset(&current->prop);
+            if (prop == 0)
+            {
+                if (!need_add)
+                {
+                    return PROP_ERR_NOT_FOUND;
+                }
+                if (new_prop_info(prop_name, strlen(prop_name), &current->prop) == NULL)
+                {
+                    return PROP_ERR_NO_SPACE;
+                }
+                if (created != NULL)
+                {
+                    *created = true;
+                }
+                prop = current->prop;
+            }
+            prop_info *info = get_prop_info(prop);
+            if (info == NULL)
+            {
+                return PROP_ERR_CORRUPT;
+            }
+            if (node != NULL)
+            {
+                *node = (const char *) current - area_->data;
+            }
+            *out = PropertyRef(this, info, prop);
+            return PROP_OK;
+        }
+
+        remain_name = seq + 1;
+        children = load_offset(&current->children);
+        if (children == 0)
+        {
+            p_bt = NULL;
+        }
+        else
+        {
+            p_bt = get_prop_bt(children);
+            if (p_bt == NULL)
+            {
+                return PROP_ERR_CORRUPT;
+            }
+        }
+        prev_bt = current;
+    }
+}
+
+AreaHandle::iterator::iterator(AreaHandle *area) : area_(area), node_(0)
+{
+    pending_.push_back(0);
+    ++(*this);
+}
+
+AreaHandle::iterator &AreaHandle::iterator::operator++()
+{
+    current_ = PropertyRef();
+    if (area_->format() == AREA_FORMAT_COMPAT)
+    {
+        // toc order, which is bionic's foreach order for these areas too
+        while (pending_[0] < area_->compat_count())
+        {
+            current_ = area_->compat_ref(pending_[0]++);
+            if (current_.is_valid())
+            {
+                break;
+            }
+        }
+        return *this;
+    }
+    while (!pending_.empty())
+    {
+        uint32_t off = pending_.back();
+        prop_bt *p_bt = area_->get_prop_bt(off);
+        pending_.pop_back();
+        if (p_bt == NULL)
+        {
+            continue;
+        }
+        PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+        // pushed in reverse so left, right, then children are visited in that order
+        uint32_t children = load_offset(&p_bt->children);
+        uint32_t right = load_offset(&p_bt->right);
+        uint32_t left = load_offset(&p_bt->left);
+        uint32_t prop = load_offset(&p_bt->prop);
+        if (children != 0)
+        {
+            pending_.push_back(children);
+        }
+        if (right != 0)
+        {
+            pending_.push_back(right);
+        }
+        if (left != 0)
+        {
+            pending_.push_back(left);
+        }
+        if (prop != 0)
+        {
+            prop_info *p_info = area_->get_prop_info(prop);
+            if (p_info != NULL)
+            {
+                current_ = PropertyRef(area_, p_info, prop);
+                node_ = off;
+                break;
+            }
+        }
+    }
+    return *this;
+}
+
+AreaHandle::sorted_iterator::sorted_iterator(AreaHandle *area) : area_(area)
+{
+    if (area->format() == AREA_FORMAT_COMPAT)
+    {
+        for (uint32_t i = area->compat_count(); i > 0; i--)
+        {
+            if (area->compat_ref(i - 1).is_valid())
+            {
+                compat_order_.push_back(i - 1);
+            }
+        }
+        // descending, so the next one comes off the back
+        std::sort(compat_order_.begin(), compat_order_.end(), [area](uint32_t a, uint32_t b) {
+            const char *one = area->compat_ref(a).name();
+            const char *two = area->compat_ref(b).name();
+            return prop_trie_cmp(one, strnlen(one, PROP_NAME_MAX), two, strnlen(two, PROP_NAME_MAX)) > 0;
+        });
+    }
+    else
+    {
+        pending_.push_back({0, 0});
+    }
+    ++(*this);
+}
+
+AreaHandle::sorted_iterator &AreaHandle::sorted_iterator::operator++()
+{
+    current_ = PropertyRef();
+    if (!compat_order_.empty())
+    {
+        current_ = area_->compat_ref(compat_order_.back());
+        compat_order_.pop_back();
+        return *this;
+    }
+    while (!pending_.empty())
+    {
+        frame &top = pending_.back();
+        prop_bt *p_bt = area_->get_prop_bt(top.off);
+        if (p_bt == NULL)
+        {
+            pending_.pop_back();
+            continue;
+        }
+        // left subtree, the node itself, its children, then the right subtree
+        uint32_t next;
+        switch (top.state++)
+        {
+        case 0:
+            PROP_STATS_ADD(COUNTER_NODES_VISITED, 1);
+            if ((next = load_offset(&p_bt->left)) != 0)
+            {
+                pending_.push_back({next, 0});
+            }
+            break;
+        case 1:
+            if ((next = load_offset(&p_bt->prop)) != 0)
+            {
+                prop_info *p_info = area_->get_prop_info(next);
+                if (p_info != NULL)
+                {
+                    current_ = PropertyRef(area_, p_info, next);
+                    return *this;
+                }
+            }
+            break;
+        case 2:
+            if ((next = load_offset(&p_bt->children)) != 0)
+            {
+                pending_.push_back({next, 0});
+            }
+            break;
+        default:
+        {
+            uint32_t right = load_offset(&p_bt->right);
+            pending_.pop_back();
+            if (right != 0)
+            {
+                pending_.push_back({right, 0});
+            }
+            break;
+        }
+        }
+    }
+    return *this;
+}
+
+PropertyStore::PropertyStore(const char *root)
+    : root_(root), split_(true), use_file_(false), info_(nullptr), prefixs_(nullptr), contexts_(nullptr),
+      serial_area_(root_ + "/" PROP_SERIAL_AREA, PROP_SERIAL_AREA), has_serial_area_(false)
+{
+}
+
+// prefix/context lists live in arena_ and go away with it
+PropertyStore::~PropertyStore()
+{
+    delete info_;
+}
+
+/**
+ * Android N之间所有属性是在/dev/__properties__文件中
+ * Android N上，每个security context对应一个文件，security context和属性前缀对应关系保存在/property_contexts文件中
+ */
+prop_error PropertyStore::open(bool use_contexts_file)
+{
+    // live or offline: a directory holds one file per context (N and later), a plain file is the pre-N area
+    struct stat st;
+    split_ = stat(root_.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    PROP_STATS_PHASE(PHASE_CONTEXTS);
+    use_file_ = use_contexts_file;
+    if (!use_file_)
+    {
+        info_ = new property_info((root_ + "/property_info").c_str());
+        if (!info_->is_valid())
+        {
+            use_file_ = true;
+        }
+    }
+    if (use_file_)
+    {
+        load_default_contexts_files();
+    }
+
+    if (!split_)
+    {
+        add_area("");
+    }
+    else if (!use_file_)
+    {
+        for (uint32_t i = 0; i < info_->get_context_size(); i++)
+        {
+            add_area(info_->get_context(i));
+        }
+    }
+    else
+    {
+        for (context_node *p_context = contexts_; p_context != NULL; p_context = p_context->next)
+        {
+            add_area(p_context->name);
+        }
+    }
+    has_serial_area_ = split_ && access(serial_area_.path().c_str(), F_OK) == 0;
+    return areas_.empty() ? PROP_ERR_NO_CONTEXT : PROP_OK;
+}
+
+void PropertyStore::add_area(std::string_view context)
+{
+    std::string path = context.empty() ? root_ : root_ + "/" + std::string(context);
+    area_index_.emplace(context, areas_.size());
+    areas_.emplace_back(path, std::string(context));
+}
+
+// https://cs.android.com/android/platform/superproject/main/+/main:system/core/init/property_service.cpp
+void PropertyStore::load_default_contexts_files()
+{
+    // the split plat_/nonplat_ files came with O, told apart by presence rather than by the sdk version
+    if (access("/system/etc/selinux/plat_property_contexts", R_OK) != -1 ||
+        access("/plat_property_contexts", R_OK) != -1)
+    {
+        if (access("/system/etc/selinux/plat_property_contexts", R_OK) != -1)
+        {
+            load_contexts_file("/system/etc/selinux/plat_property_contexts");
+            load_contexts_file("/vendor/etc/selinux/nonplat_property_contexts");
+            load_contexts_file("/vendor/etc/selinux/vendor_property_contexts");   // name changed in android P
+            load_contexts_file("/product/etc/selinux/product_property_contexts"); // Add in Android Q
+            load_contexts_file("/odm/etc/selinux/odm_property_contexts");
+            load_contexts_file("/system_ext/etc/selinux/system_ext_property_contexts"); // Add in Android R
+        }
+        else
+        {
+            load_contexts_file("/plat_property_contexts");
+            load_contexts_file("/nonplat_property_contexts");
+        }
+    }
+    else
+    {
+        load_contexts_file("/property_contexts");
+    }
+}
+
+void PropertyStore::add_prefix_node(prefix_node *node)
+{
+    if (prefixs_ == NULL)
+    {
+        prefixs_ = node;
+        return;
+    }
+    size_t len = strlen(node->name);
+    prefix_node **pp = NULL;
+    for (pp = &prefixs_; *pp != NULL; pp = &((*pp)->next))
+    {
+        if (strlen((*pp)->name) < len || !strcmp((*pp)->name, "*"))
+        {
+            node->next = *pp;
+            *pp = node;
+            return;
+        }
+    }
+    *pp = node;
+}
+
+prefix_node *PropertyStore::get_prefix_node(const char *prop_name)
+{
+    for (prefix_node *node = prefixs_; node != NULL; node = node->next)
+    {
+        if (!strncmp(node->name, prop_name, strlen(node->name)) || !strcmp(node->name, "*"))
+        {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+void PropertyStore::add_context_node(context_node *node)
+{
+    node->next = contexts_;
+    contexts_ = node;
+}
+
+context_node *PropertyStore::get_context_node(const char *context_name)
+{
+    for (context_node *node = contexts_; node != NULL; node = node->next)
+    {
+        if (!strcmp(node->name, context_name))
+        {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+bool PropertyStore::load_contexts_file(const char *context_file)
+{
+    FILE *file = fopen(context_file, "r");
+    if (!file)
+    {
+        return false;
+    }
+    char *buffer = NULL;
+    char *p = NULL;
+    char *prop_prefix = NULL;
+    char *prop_context = NULL;
+    size_t len = 0;
+    while (getline(&buffer, &len, file) > 0)
+    {
+        p = buffer;
+        while (isspace(*p))
+            p++;
+        if (*p == '#' || *p == '\0')
+        {
+            continue;
+        }
+        prop_prefix = p;
+        while (!isspace(*p) && *p != '\0')
+        {
+            p++;
+        }
+        std::string_view prefix(prop_prefix, p - prop_prefix);
+
+        while (isspace(*p))
+            p++;
+        if (*p == '\0')
+        {
+            continue;
+        }
+        prop_context = p;
+        while (!isspace(*p) && *p != '\0')
+        {
+            p++;
+        }
+        *p = '\0';
+        context_node *p_context = get_context_node(prop_context);
+        if (p_context == NULL)
+        {
+            p_context = arena_.make_array<context_node>(1);
+            p_context->name = arena_.copy(prop_context).data();
+            add_context_node(p_context);
+        }
+        prefix_node *p_prefix = arena_.make_array<prefix_node>(1);
+        p_prefix->name = arena_.copy(prefix).data();
+        p_prefix->context = p_context;
+        add_prefix_node(p_prefix);
+    }
+
+    free(buffer);
+    fclose(file);
+    return true;
+}
+
+std::string_view PropertyStore::context_of(const char *prop_name)
+{
+    if (info_ != nullptr && !use_file_)
+    {
+        return info_->get_context(prop_name);
+    }
+    /**
+     * below Android N, ingnore "ro." prefix in the property_contexts file
+     */
+    if (!split_ && !strncmp(prop_name, "ro.", strlen("ro.")))
+    {
+        prop_name += strlen("ro.");
+    }
+    prefix_node *p_prefix = get_prefix_node(prop_name);
+    if (p_prefix == NULL || p_prefix->context == NULL)
+    {
+        return "";
+    }
+    return p_prefix->context->name;
+}
+
+prop_error PropertyStore::area_for(const char *prop_name, bool writable, AreaHandle **out)
+{
+    size_t index = 0;
+    if (split_)
+    {
+        std::map<std::string, size_t, std::less<>>::iterator it;
+        if (!use_file_)
+        {
+            uint32_t context_index = info_->get_context_index(prop_name);
+            if (context_index >= areas_.size())
+            {
+                return PROP_ERR_NO_CONTEXT;
+            }
+            index = context_index;
+        }
+        else
+        {
+            prefix_node *p_prefix = get_prefix_node(prop_name);
+            if (p_prefix == NULL || p_prefix->context == NULL ||
+                (it = area_index_.find(p_prefix->context->name)) == area_index_.end())
+            {
+                return PROP_ERR_NO_CONTEXT;
+            }
+            index = it->second;
+        }
+    }
+    AreaHandle &area = areas_[index];
+    *out = &area;
+    return area.map(writable);
+}
+
+prop_error PropertyStore::get(const char *prop_name, PropertyRef *out)
+{
+    AreaHandle *area = nullptr;
+    prop_error err = area_for(prop_name, false, &area);
+    if (err != PROP_OK)
+    {
+        return err;
+    }
+    return area->find(prop_name, out);
+}
+
+prop_error PropertyStore::set(const char *prop_name, const char *value, uint32_t count, bool create,
+                              PropertyRef *out, bool *changed)
+{
+    if (value != NULL && strlen(value) >= PROP_VALUE_MAX)
+    {
+        return PROP_ERR_INVALID;
+    }
+    // looked up read-only first, the area only becomes writable when something changes
+    AreaHandle *area = nullptr;
+    prop_error err = area_for(prop_name, false, &area);
+    if (err != PROP_OK)
+    {
+        return err;
+    }
+    PropertyRef ref;
+    err = area->find(prop_name, &ref);
+    if (err == PROP_ERR_NOT_FOUND && create)
+    {
+        if ((err = area->map(true)) == PROP_OK)
+        {
+            err = area->add(prop_name, &ref);
+        }
+    }
+    if (err != PROP_OK)
+    {
+        return err;
+    }
+    if (out != NULL)
+    {
+        *out = ref;
+    }
+    if (ref.info()->needs_update(value, count) && (err = area->map(true)) != PROP_OK)
+    {
+        return err;
+    }
+    return ref.update(value, count, changed);
+}
+
+prop_error PropertyStore::remove(const char *prop_name)
+{
+    AreaHandle *area;
+    prop_error err = area_for(prop_name, true, &area);
+    return err != PROP_OK ? err : area->remove(prop_name);
+}
+
+void PropertyStore::set_reuse_free(bool reuse)
+{
+    for (AreaHandle &area : areas_)
+    {
+        area.set_reuse_free(reuse);
+    }
+}
+
+void PropertyStore::set_audit(PropAuditLog *audit)
+{
+    for (AreaHandle &area : areas_)
+    {
+        area.set_audit(audit);
+    }
+}
+
+prop_error PropertyStore::set_counts(const std::vector<PropertyRef> &refs, uint32_t count,
+                                     std::vector<bool> *changed)
+{
+    changed->assign(refs.size(), false);
+    // phase 1: read-only scan for the areas that really have a counter to change
+    std::vector<AreaHandle *> dirty;
+    for (const PropertyRef &ref : refs)
+    {
+        if (ref.count() != count && std::find(dirty.begin(), dirty.end(), ref.area()) == dirty.end())
+        {
+            dirty.push_back(ref.area());
+        }
+    }
+    // phase 2: only those areas are remapped writable, and only differing serial words are stored
+    prop_error result = PROP_OK;
+    for (AreaHandle *area : dirty)
+    {
+        prop_error err = area->map(true);
+        AreaWriteLock lock(area);
+        if (err == PROP_OK)
+        {
+            err = lock.error();
+        }
+        if (err != PROP_OK)
+        {
+            result = err;
+            continue;
+        }
+        for (size_t i = 0; i < refs.size(); i++)
+        {
+            if (refs[i].area() != area)
+            {
+                continue;
+            }
+            uint32_t old_serial = refs[i].serial();
+            if (refs[i].info()->set_count(count))
+            {
+                prop_futex_wake(&refs[i].info()->serial);
+                if (area->audit() != nullptr)
+                {
+                    area->audit()->record(AUDIT_COUNT, refs[i].name(), refs[i].value(), old_serial,
+                                          refs[i].value(), refs[i].serial());
+                }
+                (*changed)[i] = true;
+                PROP_STATS_ADD(COUNTER_SERIALS_WRITTEN, 1);
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "prop_area.h"
+#include "prop_arena.h"
+#include "property_info.h"
+
+/**
+ * Library side of system_properties: maps property areas, resolves a property
+ * name to its area and reads/writes prop_info in place. Nothing here prints;
+ * every operation reports a prop_error and the caller decides what to show.
+ */
+
+enum prop_error
+{
+    PROP_OK = 0,
+    PROP_ERR_NOT_FOUND,     // property (or one of its name segments) doesn't exist
+    PROP_ERR_NO_CONTEXT,    // no security context / area file for the name
+    PROP_ERR_OPEN,          // open() failed, errno is kept in AreaHandle::last_errno()
+    PROP_ERR_BAD_AREA,      // file size or header doesn't look like a prop_area
+    PROP_ERR_MAP,           // mmap() failed
+    PROP_ERR_READ_ONLY,     // write requested on an area mapped read-only
+    PROP_ERR_NO_SPACE,      // area doesn't have room for new prop_bt/prop_info
+    PROP_ERR_INVALID,       // bad name or value
+    PROP_ERR_CORRUPT,       // offset inside the area points out of range
+    PROP_ERR_LOCK,          // the area file can't be opened for writing or locked
+    PROP_ERR_BAD_VERSION,   // prop_area magic/version of a layout this code can't read
+    PROP_ERR_PERMISSION,    // the caller may not write (e.g. a --serve client)
+};
+
+const char *prop_strerror(prop_error err);
+
+// layout of the area file at path from its header, AREA_FORMAT_UNKNOWN for anything else
+prop_area_format probe_area_file(const char *path);
+
+/**
+ * Futex ops on a serial word of a shared area mapping, like bionic's
+ * __futex_wait/__futex_wake (not FUTEX_PRIVATE, waiters are other processes).
+ * The wait returns 0 when woken, or -1 with errno EAGAIN (word != expected),
+ * EINTR or ETIMEDOUT. timeout is relative, NULL waits forever. This tool's
+ * writes only wake prop_info serials; the properties_serial word is init's.
+ */
+int prop_futex_wait(const uint32_t *word, uint32_t expected, const struct timespec *timeout);
+void prop_futex_wake(uint32_t *word);
+
+/**
+ * Order of names in the prop_bt trie: segment by segment, shorter segments
+ * first, then by bytes; a name sorts before the names below it.
+ */
+int prop_trie_cmp(const char *one, size_t one_len, const char *two, size_t two_len);
+
+/**
+ * A name bionic can find again: not empty, no leading or trailing '.' and no
+ * empty segment ("a..b"); find_property() stops at an empty segment, so a
+ * property added under one would be unreachable.
+ */
+bool prop_name_valid(std::string_view name);
+
+int get_sdk_version();
+
+/** 属性前缀 */
+typedef struct prefix_node
+{
+    const char *name;
+    struct context_node *context;
+    struct prefix_node *next;
+} prefix_node;
+
+/** 属性对应的security context */
+typedef struct context_node
+{
+    const char *name;
+    void *mem;
+    struct context_node *next;
+} context_node;
+
+class AreaHandle;
+class PropAuditLog;
+
+/** A prop_info living inside a mapped area. Only valid while the area stays mapped. */
+class PropertyRef
+{
+public:
+    PropertyRef() : area_(nullptr), info_(nullptr), name_(nullptr), offset_(0) {}
+    PropertyRef(AreaHandle *area, prop_info *info, uint32_t offset)
+        : area_(area), info_(info), name_(info->name), offset_(offset) {}
+    // compat entries: info points at the serial word, the name is stored in front of it
+    PropertyRef(AreaHandle *area, prop_info *info, const char *name, uint32_t offset)
+        : area_(area), info_(info), name_(name), offset_(offset) {}
+
+    bool is_valid() const { return info_ != nullptr; }
+    AreaHandle *area() const { return area_; }
+    prop_info *info() const { return info_; }
+    uint32_t offset() const { return offset_; }
+
+    const char *name() const { return name_; }
+    const char *value() const { return info_->value; }
+    uint32_t serial() const { return info_->get_serial(); }
+    uint32_t count() const { return info_->get_count(); }
+
+    // value == NULL keeps the value, count == PROP_COUNT_MAX keeps the count
+    prop_error update(const char *value, uint32_t count, bool *changed);
+    // puts back a serial/value pair saved earlier, e.g. from a journal
+    prop_error restore(uint32_t serial, const char *value);
+
+private:
+    AreaHandle *area_;
+    prop_info *info_;
+    const char *name_;
+    uint32_t offset_;
+};
+
+/**
+ * Open-addressing table from full property name to prop_info offset for one
+ * area. It is filled in a single walk of the trie and only trusted while the
+ * area's bytes_used and free list head are the ones it was built from; init
+ * never moves the area serial, so that can't be the key. A hit is checked
+ * against the prop_bt that pointed at it, which a delete clears.
+ */
+struct name_index
+{
+    std::vector<uint32_t> offsets;  // prop_info offset, 0 = empty slot
+    std::vector<uint32_t> hashes;
+    std::vector<uint32_t> nodes;    // prop_bt whose prop is the offset
+    uint32_t bytes_used = 0;
+    uint32_t free_list = 0;
+    bool built = false;
+    uint32_t lookups = 0;           // finds since the area was mapped
+};
+
+/**
+ * RAII mapping of one property area file.
+ *
+ * Writers from different processes are kept apart with an OFD fcntl() lock
+ * on an fd of the area file itself; init and bionic never take it, and no
+ * file is created next to the area. add(), PropertyRef::update() and
+ * restore() take the lock themselves; a caller doing several writes can
+ * hold an AreaWriteLock around them, the lock nests. Readers never lock.
+ */
+class AreaHandle
+{
+public:
+    AreaHandle(const std::string &path, const std::string &context);
+    AreaHandle(AreaHandle &&other) noexcept;
+    AreaHandle &operator=(AreaHandle &&other) noexcept;
+    AreaHandle(const AreaHandle &) = delete;
+    AreaHandle &operator=(const AreaHandle &) = delete;
+    ~AreaHandle();
+
+    /**
+     * Maps the file, or remaps it writable if it is only mapped read-only.
+     * The layout comes from the header, read before mapping; unknown ones
+     * fail with PROP_ERR_BAD_VERSION and compat areas only map read-only.
+     */
+    prop_error map(bool writable);
+    void unmap();
+
+    bool is_mapped() const { return area_ != nullptr; }
+    bool is_writable() const { return writable_; }
+    int last_errno() const { return errno_; }
+    const std::string &path() const { return path_; }
+    const std::string &context() const { return context_; }
+    prop_area *area() const { return area_; }
+    // bytes mapped, the whole file
+    size_t size() const { return size_; }
+    prop_area_format format() const { return format_; }
+
+    prop_bt *get_prop_bt(uint32_t off) const;
+    prop_info *get_prop_info(uint32_t off) const;
+
+    // the first INDEX_MIN_LOOKUPS finds walk the trie, later ones go through the name index
+    prop_error find(const char *prop_name, PropertyRef *out);
+    // like find(), creating missing prop_bt/prop_info on the way
+    prop_error add(const char *prop_name, PropertyRef *out);
+    /**
+     * Unlinks the prop_info and every prop_bt left without a property or
+     * children. A node with two siblings is replaced by its in-order
+     * successor, so the BST doesn't get deeper. Lock-free readers may briefly
+     * miss a sibling while it moves. The bytes stay as they are unless free
+     * space reuse is on, see set_reuse_free().
+     */
+    prop_error remove(const char *prop_name);
+    // number of leading name segments that already have a prop_bt
+    uint32_t existing_segments(const char *prop_name) const;
+    /**
+     * prop_bt of the last segment of prefix, the root node for "", NULL when
+     * a segment is missing or the area isn't a trie. nodes is increased by
+     * the prop_bt compared on the way.
+     */
+    prop_bt *find_prefix(const char *prefix, uint32_t *nodes) const;
+
+    prop_error lock_write();
+    void unlock_write();
+    /**
+     * FNV-1a 64 of bytes_used and the data in use, a word at a time (the
+     * whole mapping for compat areas). Any write to a property, ours or
+     * init's, changes it; the serial words in the header don't.
+     */
+    uint64_t content_hash() const;
+    /**
+     * Off by default. When on, remove() puts the freed bytes on a free list
+     * chained from the header's reserved[AREA_FREE_LIST] word, and adds take
+     * them before growing bytes_used. A prop_info pointer cached by any
+     * process (bionic's CachedProperty keeps one per property) then reads
+     * whatever reuses the bytes, so only turn it on for copies of the areas.
+     */
+    void set_reuse_free(bool reuse) { reuse_free_ = reuse; }
+    // ring that every write to this area is recorded in, NULL for none
+    void set_audit(PropAuditLog *audit) { audit_ = audit; }
+    PropAuditLog *audit() const { return audit_; }
+
+    /** Visits every prop_info in the same order as bionic's foreach. */
+    class iterator
+    {
+    public:
+        iterator() : area_(nullptr), node_(0) {}
+        iterator(AreaHandle *area);
+
+        PropertyRef operator*() const { return current_; }
+        // prop_bt holding the current prop_info, 0 in compat areas
+        uint32_t node_offset() const { return node_; }
+        iterator &operator++();
+        bool operator==(const iterator &other) const { return current_.info() == other.current_.info(); }
+        bool operator!=(const iterator &other) const { return !(*this == other); }
+
+    private:
+        AreaHandle *area_;
+        // trie offsets still to visit, or the next toc slot of a compat area
+        std::vector<uint32_t> pending_;
+        PropertyRef current_;
+        uint32_t node_;
+    };
+
+    iterator begin() { return is_mapped() ? iterator(this) : iterator(); }
+    iterator end() { return iterator(); }
+
+    /** Visits every prop_info in prop_trie_cmp() order (in-order walk of each level). */
+    class sorted_iterator
+    {
+    public:
+        sorted_iterator() : area_(nullptr) {}
+        sorted_iterator(AreaHandle *area);
+
+        PropertyRef operator*() const { return current_; }
+        sorted_iterator &operator++();
+        bool operator==(const sorted_iterator &other) const { return current_.info() == other.current_.info(); }
+        bool operator!=(const sorted_iterator &other) const { return !(*this == other); }
+
+    private:
+        struct frame
+        {
+            uint32_t off;
+            uint8_t state;
+        };
+        AreaHandle *area_;
+        std::vector<frame> pending_;
+        // compat areas have no order of their own, their toc slots are sorted up front
+        std::vector<uint32_t> compat_order_;
+        PropertyRef current_;
+    };
+
+    sorted_iterator sorted_begin() { return is_mapped() ? sorted_iterator(this) : sorted_iterator(); }
+    sorted_iterator sorted_end() { return sorted_iterator(); }
+
+    static const uint32_t INDEX_MIN_LOOKUPS = 4;
+
+private:
+    // created is set when need_add made a new prop_info, node to the prop_bt pointing at it
+    prop_error find_prop_info(const char *prop_name, bool need_add, PropertyRef *out, bool *created = nullptr,
+                              uint32_t *node = nullptr);
+    uint32_t compat_count() const;
+    // entry of toc slot i, an invalid ref if the slot points out of the file
+    PropertyRef compat_ref(uint32_t i);
+    prop_error find_compat(const char *prop_name, PropertyRef *out);
+    bool index_is_fresh() const;
+    void build_index();
+    void index_insert(uint32_t hash, uint32_t off, uint32_t node);
+    // first fit from the free list when reusing, else the end of the used space
+    bool alloc_obj(uint32_t size, uint32_t *off);
+    void free_obj(uint32_t off, uint32_t size);
+    void unlink_bt(uint32_t *link, uint32_t off);
+    prop_bt *new_prop_bt(const char *name, uint8_t namelen, uint32_t *off);
+    prop_info *new_prop_info(const char *prop_name, uint8_t namelen, uint32_t *off);
+
+    std::string path_;
+    std::string context_;
+    prop_area *area_;
+    size_t size_;
+    prop_area_format format_;
+    bool writable_;
+    int errno_;
+    int lock_fd_;
+    int lock_depth_;
+    bool reuse_free_;
+    name_index index_;
+    PropAuditLog *audit_;
+};
+
+class AreaWriteLock
+{
+public:
+    explicit AreaWriteLock(AreaHandle *area) : area_(area), err_(area->lock_write()) {}
+    ~AreaWriteLock()
+    {
+        if (err_ == PROP_OK)
+        {
+            area_->unlock_write();
+        }
+    }
+    AreaWriteLock(const AreaWriteLock &) = delete;
+    AreaWriteLock &operator=(const AreaWriteLock &) = delete;
+
+    prop_error error() const { return err_; }
+
+private:
+    AreaHandle *area_;
+    prop_error err_;
+};
+
+/**
+ * All property areas of one device (or of an offline copy under root).
+ * Areas are mapped on first use and stay mapped until the store is destroyed,
+ * so a long-running caller pays for the context index and the mmaps once.
+ */
+class PropertyStore
+{
+public:
+    explicit PropertyStore(const char *root = PROPERTIES_FILE);
+    ~PropertyStore();
+    PropertyStore(const PropertyStore &) = delete;
+    PropertyStore &operator=(const PropertyStore &) = delete;
+
+    // use_contexts_file: resolve contexts from property_contexts instead of property_info
+    prop_error open(bool use_contexts_file = false);
+
+    const std::string &root() const { return root_; }
+    bool is_split() const { return split_; }
+    bool uses_contexts_file() const { return use_file_; }
+    // the property_info index used for contexts, NULL when resolving from property_contexts
+    property_info *context_info() const { return use_file_ ? nullptr : info_; }
+
+    size_t area_count() const { return areas_.size(); }
+    AreaHandle &area_at(size_t index) { return areas_[index]; }
+    // area holding prop_name, mapped (writable if asked)
+    prop_error area_for(const char *prop_name, bool writable, AreaHandle **out);
+    // security context of prop_name, empty if unknown; NUL terminated, valid while the store lives
+    std::string_view context_of(const char *prop_name);
+
+    prop_error get(const char *prop_name, PropertyRef *out);
+    // create: add the property if it doesn't exist yet
+    prop_error set(const char *prop_name, const char *value, uint32_t count, bool create,
+                   PropertyRef *out, bool *changed);
+    /**
+     * Sets the counter of every ref in two phases: a read-only scan finds the
+     * areas with a counter that differs, only those are remapped writable and
+     * only the differing serial words are written. changed is parallel to refs.
+     */
+    prop_error set_counts(const std::vector<PropertyRef> &refs, uint32_t count, std::vector<bool> *changed);
+    // deletes prop_name from its area, see AreaHandle::remove()
+    prop_error remove(const char *prop_name);
+    // AreaHandle::set_reuse_free() on every area, call after open(); never on the live areas
+    void set_reuse_free(bool reuse);
+    // records every later write to any area in audit (an open PropAuditLog), call after open()
+    void set_audit(PropAuditLog *audit);
+
+    // the properties_serial area of a split root, moved by init on every change; NULL when there is none
+    AreaHandle *serial_area() { return has_serial_area_ ? &serial_area_ : nullptr; }
+
+    std::vector<AreaHandle>::iterator begin() { return areas_.begin(); }
+    std::vector<AreaHandle>::iterator end() { return areas_.end(); }
+
+private:
+    bool load_contexts_file(const char *context_file);
+    void load_default_contexts_files();
+    void add_prefix_node(prefix_node *node);
+    prefix_node *get_prefix_node(const char *prop_name);
+    void add_context_node(context_node *node);
+    context_node *get_context_node(const char *context_name);
+    void add_area(std::string_view context);
+
+    std::string root_;
+    bool split_;
+    bool use_file_;
+    property_info *info_;
+    PropArena arena_;
+    prefix_node *prefixs_;
+    context_node *contexts_;
+    std::vector<AreaHandle> areas_;
+    std::map<std::string, size_t, std::less<>> area_index_;
+    AreaHandle serial_area_;
+    bool has_serial_area_;
+};
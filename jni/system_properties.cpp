@@ -2,656 +2,621 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <unistd.h>
-#include <sys/mman.h>
 #include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <getopt.h>
 #include <errno.h>
 
 #include <android/log.h>
-#include <sys/system_properties.h>
 
-#include <map>
 #include <algorithm>
 
 #include "system_properties.h"
+#include "prop_server.h"
+#include "prop_transaction.h"
+#include "prop_import.h"
+#include "prop_diff.h"
+#include "prop_summary.h"
+#include "prop_verify.h"
+#include "prop_cache.h"
+#include "prop_wait.h"
+#include "prop_audit.h"
+#include "prop_reader_bench.h"
+#include "prop_trace.h"
+#include "prop_ls.h"
+#include "prop_guard.h"
+#include "prop_info_build.h"
+#include "prop_clone.h"
+#include "persistent_properties.h"
+#include "prop_stats.h"
 
 
-std::vector<prop_content> prop_all;
+// int g_log_type = LOG_TYPE_CONSOLE + LOG_TYPE_LOGCAT; // 默认输出到logcat和console
+int g_log_type = LOG_TYPE_CONSOLE; // set default output to console
 
+bool g_need_security_context = false;
+bool g_verbose_mode = false;
+
+PropArena g_arena(64 * 1024);
+std::vector<prop_content, ArenaAllocator<prop_content>> prop_all{ArenaAllocator<prop_content>(&g_arena)};
 
-void add_prefix_node(prefix_node *node)
-{
-    if (g_prefixs == NULL)
-    {
-        g_prefixs = node;
-        return;
-    }
-    int len = strlen(node->name);
-    prefix_node **pp = NULL;
-    for (pp = &g_prefixs; *pp != NULL; pp = &((*pp)->next))
-    {
-        if (strlen((*pp)->name) < len || !strcmp((*pp)->name, "*"))
-        {
-            node->next = *pp;
-            *pp = node;
-            return;
-        }
-    }
-    *pp = node;
-}
 
-prefix_node *get_prefix_node(const char *prop_name)
+void print_log(const char *format, ...)
 {
-    if (g_prefixs == NULL)
+    char buffer[LOG_BUFFER];
+    va_list args;
+    va_start(args, format);
+    vsprintf(buffer, format, args);
+    if ((g_log_type & LOG_TYPE_LOGCAT) != 0)
     {
-        return NULL;
+        LOGD("%s", buffer);
     }
-    for (prefix_node *node = g_prefixs; node != NULL; node = node->next)
+    if ((g_log_type & LOG_TYPE_CONSOLE) != 0)
     {
-        if (!strncmp(node->name, prop_name, strlen(node->name)) || !strcmp(node->name, "*"))
-        {
-            return node;
-        }
+        printf("%s", buffer);
     }
-    return NULL;
+    va_end(args);
 }
 
-void add_context_node(context_node *node)
+void report_error(prop_error err, AreaHandle *area)
 {
-    if (g_contexts == NULL)
+    switch (err)
     {
-        g_contexts = node;
-        return;
-    }
-    node->next = g_contexts;
-    g_contexts = node;
-}
-
-context_node *get_context_node(const char *context_name)
-{
-    if (g_contexts == NULL)
-    {
-        return NULL;
-    }
-    for (context_node *node = g_contexts; node != NULL; node = node->next)
-    {
-        if (!strcmp(node->name, context_name))
+    case PROP_OK:
+    case PROP_ERR_NOT_FOUND:
+        break;
+    case PROP_ERR_OPEN:
+        if (area->last_errno() == EACCES && geteuid() == 0) // only print when run as root.
         {
-            return node;
+            fprintf(stderr, "open file[%s] error[%d]:%s\n", area->path().c_str(), area->last_errno(),
+                    strerror(area->last_errno()));
         }
+        break;
+    case PROP_ERR_BAD_AREA:
+        print_log("file [%s] is not a property area\n", area->path().c_str());
+        break;
+    case PROP_ERR_BAD_VERSION:
+        print_log("file [%s] has an unsupported area format\n", area->path().c_str());
+        break;
+    case PROP_ERR_MAP:
+        fprintf(stderr, "map failed!: %s\n", strerror(area->last_errno()));
+        break;
+    case PROP_ERR_NO_SPACE:
+        fprintf(stderr, "no enough space, total:[%u] used:[%u]\n", AREA_DATA_SIZE, area->area()->bytes_used);
+        break;
+    default:
+        fprintf(stderr, "%s!\n", prop_strerror(err));
+        break;
     }
-    return NULL;
 }
 
-bool initialize_contexts(const char *context_file)
+/**
+ * 打印所有属性
+ *  Android N之间所有属性是在/dev/__properties__文件中
+ *  Android N上，每个security context对应一个文件，security context和属性前缀对应关系保存在/property_contexts文件中
+ */
+void dump_all(PropertyStore &store, DumpCache *cache)
 {
-    FILE *file = fopen(context_file, "r");
-    if (!file)
-    {
-        return false;
-    }
-    char *buffer = NULL;
-    char *p = NULL;
-    char *prop_prefix = NULL;
-    char *prop_context = NULL;
-    size_t len = 0;
-    while (getline(&buffer, &len, file) > 0)
+    PROP_STATS_PHASE(PHASE_TRAVERSE);
+    prop_all.clear();
+    for (AreaHandle &area : store)
     {
-        p = buffer;
-        while (isspace(*p))
-            p++;
-        if (*p == '#' || *p == '\0')
-        {
-            continue;
-        }
-        prop_prefix = p;
-        while (!isspace(*p) && *p != '\0')
-        {
-            p++;
-        }
-        prefix_node *p_prefix = (prefix_node *)calloc(1, sizeof(prefix_node));
-        p_prefix->name = (char *)calloc(1, p - prop_prefix + 1);
-        strncpy(p_prefix->name, prop_prefix, p - prop_prefix);
-
-        while (isspace(*p))
-            p++;
-        if (*p == '\0')
+        prop_error err = area.map(false);
+        if (err != PROP_OK)
         {
-            free(p_prefix->name);
-            free(p_prefix);
+            report_error(err, &area);
             continue;
         }
-        prop_context = p;
-        while (!isspace(*p) && *p != '\0')
+        size_t first = prop_all.size();
+        // hashed before the walk: a change during it makes the next run miss instead of serving stale data
+        uint64_t hash = cache != NULL ? area.content_hash() : 0;
+        if (cache == NULL || !cache->splice(area, hash, prop_all))
         {
-            p++;
+            for (PropertyRef ref : area)
+            {
+                // the mapping stays at the same address for the whole run, even when made writable
+                prop_content content;
+                content.name = ref.name();
+                content.value = ref.value();
+                content.serial = ref.serial();
+                prop_all.push_back(content);
+            }
+            if (cache != NULL)
+                cache->update(area, hash, &prop_all[first], prop_all.size() - first);
         }
-        *p = '\0';
-        context_node *p_context = get_context_node(prop_context);
-        if (p_context == NULL)
+        if (g_need_security_context)
         {
-            p_context = (context_node *)calloc(1, sizeof(context_node));
-            p_context->name = (char *)calloc(1, strlen(prop_context) + 1);
-            strcpy(p_context->name, prop_context);
-            add_context_node(p_context);
+            // cached names aren't NUL terminated
+            for (size_t i = first; i < prop_all.size(); i++)
+                prop_all[i].security = store.is_split() ? std::string_view(area.context())
+                                                        : store.context_of(std::string(prop_all[i].name).c_str());
         }
-        p_prefix->context = p_context;
-        add_prefix_node(p_prefix);
     }
-
-    free(buffer);
-    fclose(file);
-    return true;
+    if (cache != NULL && !cache->save())
+        fprintf(stderr, "can't write dump cache: %s\n", strerror(errno));
 }
 
-void cleanup_resource()
+bool match_prop_name(std::string_view sv, std::string_view name)
 {
-    prefix_node *p = g_prefixs, *pp;
-    while (p != NULL)
-    {
-        pp = p;
-        p = p->next;
-        free(pp->name);
-        free(pp);
-    }
-    context_node *q = g_contexts, *qq;
-    while (q != NULL)
-    {
-        qq = q;
-        q = q->next;
-        free(qq->name);
-        free(qq);
-    }
+    return sv == "**" ||
+           (sv.starts_with("*") && name.ends_with(sv.substr(1))) ||
+           (sv.ends_with("*") && name.starts_with(sv.substr(0, sv.size() - 1))) ||
+           (sv.starts_with("*") && sv.ends_with("*") && name.find(sv.substr(1, sv.size() - 2)) != std::string::npos);
 }
 
-prop_area *map_prop_area(const char *file_name, bool need_write)
+void filter_all(const char *prop_name)
 {
-    int open_flag;
-    int map_prot_flag;
-    if (need_write)
-    {
-        open_flag = O_RDWR;
-        map_prot_flag = PROT_READ | PROT_WRITE;
-    }
-    else
-    {
-        open_flag = O_RDONLY;
-        map_prot_flag = PROT_READ;
-    }
-    int fd = open(file_name, open_flag);
-    if (fd == -1)
-    {
-        // if (errno == EACCES)
-        if (errno == EACCES && geteuid() == 0) // only print when run as root.
-        {
-            fprintf(stderr, "open file[%s] error[%d]:%s\n", file_name, errno, strerror(errno));
-        }
-        return NULL;
-    }
-    struct stat fd_stat;
-    if (fstat(fd, &fd_stat) < 0)
-    {
-        perror("cannot get stat:");
-        close(fd);
-        return NULL;
-    }
-    if (fd_stat.st_size != AREA_SIZE)
-    {
-        print_log("file [%s] size is not equal %x\n", file_name, AREA_SIZE);
-        close(fd);
-        return NULL;
-    }
-    void *addr = mmap(NULL, fd_stat.st_size, map_prot_flag, MAP_SHARED, fd, 0);
-    if (addr == MAP_FAILED)
+    PROP_STATS_PHASE(PHASE_FILTER);
+    if (prop_name == NULL || strlen(prop_name) < 2)
     {
-        perror("map failed!");
-        close(fd);
-        return NULL;
+        std::sort(prop_all.begin(), prop_all.end());
+        return;
     }
-    close(fd);
-    return (prop_area *)addr;
+    std::string_view sv(prop_name);
+    std::erase_if(prop_all, [sv](const prop_content &p) { return !match_prop_name(sv, p.name); });
+    std::sort(prop_all.begin(), prop_all.end());
+    return;
 }
 
-prop_bt *get_prop_bt(prop_area *p_area, uint32_t off)
+void print_property(PropertyStore &store, PropertyRef &ref, uint32_t prop_count, bool changed)
 {
-    if (off > AREA_DATA_SIZE)
+    PROP_STATS_PHASE(PHASE_OUTPUT);
+    if (changed)
     {
-        fprintf(stderr, "exceed the limit\n");
-        return NULL;
+        if (g_verbose_mode)
+            print_log("set %s -> %s, valuelen %d count %d\n", ref.name(), ref.value(),
+                        ref.serial() >> 24, ref.count());
+        else
+            print_log("set ");
     }
-    return (prop_bt *)(p_area->data + off);
-}
-
-prop_bt *new_prop_bt(prop_area *p_area, const char *name, uint8_t namelen, uint32_t *off)
-{
-    uint32_t need_size = ALIGN(sizeof(prop_bt) + namelen + 1, sizeof(uint32_t));
-    if (p_area->bytes_used + need_size > AREA_DATA_SIZE)
-    {
-        fprintf(stderr, "no enough space, total:[%u] used:[%u], need:[%u]\n", AREA_DATA_SIZE,
-                p_area->bytes_used, need_size);
-        return NULL;
-    }
-    *off = p_area->bytes_used;
-    p_area->bytes_used += need_size;
-    prop_bt *bt = (prop_bt *)(p_area->data + *off);
-    memset(bt, 0, sizeof(prop_bt));
-    bt->namelen = namelen;
-    memcpy(bt->name, name, namelen);
-    bt->name[namelen] = '\0';
-    return bt;
-}
-
-prop_info *get_prop_info(prop_area *p_area, uint32_t off)
-{
-    if (off > AREA_DATA_SIZE)
+    print_log("[%s]: [%s]", ref.name(), ref.value());
+    if (ref.count() || prop_count != PROP_COUNT_MAX || g_verbose_mode)
+        print_log(" count %d", ref.count());
+    if (g_verbose_mode)
+        print_log(" serial 0x%08X",  ref.serial());
+    if (g_need_security_context)
     {
-        fprintf(stderr, "exceed the limit\n");
-        return NULL;
+        print_log(" context: [%s]", store.context_of(ref.name()).data());
     }
-    prop_info *result = (prop_info *)(p_area->data + off);
-    return result;
+    print_log("\n");
 }
 
-prop_info *new_prop_info(prop_area *p_area, const char *prop_name, uint8_t namelen, uint32_t *off)
+void get_or_set_property_value_count(PropertyStore &store, const char *prop_name, const char *prop_value,
+                                     uint32_t prop_count, bool need_confirm)
 {
-    uint32_t need_size = ALIGN(sizeof(prop_info) + namelen + 1, sizeof(uint32_t));
-    if (p_area->bytes_used + need_size > AREA_DATA_SIZE)
-    {
-        fprintf(stderr, "no enough space, total:[%u] used:[%u], need:[%u]\n", AREA_DATA_SIZE,
-                p_area->bytes_used, need_size);
-        return NULL;
-    }
-    *off = p_area->bytes_used;
-    p_area->bytes_used += need_size;
-    prop_info *info = (prop_info *)(p_area->data + *off);
-    memset(info, 0, sizeof(prop_info));
-    memcpy(info->name, prop_name, namelen);
-    info->name[namelen] = '\0';
-    return info;
-}
-
-int get_sdk_version();
-
-char *get_security_context(char *prop_name)
-{
-    if (g_current_security_context != NULL)
+    // mapped read-only until it is clear that something has to be written
+    bool need_write = prop_value != NULL || prop_count != PROP_COUNT_MAX;
+    AreaHandle *p_area = NULL;
+    prop_error err = store.area_for(prop_name, false, &p_area);
+    if (err != PROP_OK)
     {
-        return g_current_security_context;
+        report_error(err, p_area);
+        return;
     }
-
-    /**
-     * below Android N, ingnore "ro." prefix in the property_contexts file
-     */
-    if (get_sdk_version() < ANDROID_N)
+    PropertyRef ref;
+    err = p_area->find(prop_name, &ref);
+    if (err == PROP_ERR_NOT_FOUND && need_write)
     {
-        char *name = strstr(prop_name, "ro.");
-        if (name != NULL && strlen(name) == strlen(prop_name))
+        if (need_confirm)
         {
-            prop_name = prop_name + strlen("ro.");
+            printf("prop [%s] doesn't exist, create it? y*/n\n", prop_name);
+            char ans = getchar();
+            if (ans == 'n' || ans == 'N')
+                return;
         }
+        if ((err = p_area->map(true)) == PROP_OK)
+            err = p_area->add(prop_name, &ref);
     }
-    prefix_node *p_prefix = get_prefix_node(prop_name);
-    if (p_prefix == NULL || p_prefix->context == NULL)
-    {
-        return NULL;
-    }
-    else
-    {
-        return p_prefix->context->name;
-    }
-}
-
-void recursive(prop_area *p_area, uint32_t off, const char *file_name = NULL)
-{
-    prop_bt *p_bt = get_prop_bt(p_area, off);
-    if (p_bt == NULL)
+    if (err != PROP_OK)
     {
+        report_error(err, p_area);
         return;
     }
-    if (p_bt->prop != 0)
+    if (need_write)
     {
-        prop_info *p_info = get_prop_info(p_area, p_bt->prop);
-        if (p_info != NULL)
+        bool changed = false;
+        if (ref.info()->needs_update(prop_value, prop_count))
+            err = p_area->map(true);
+        if (err == PROP_OK)
+            err = ref.update(prop_value, prop_count, &changed);
+        if (err != PROP_OK)
         {
-            prop_content content;
-            content.name = std::string(p_info->name);
-            content.value = std::string(p_info->value);
-            content.serial = p_info->serial;
-            if (file_name != NULL && g_need_security_context)
-                content.security = std::string(file_name).substr(strlen(PROPERTIES_FILE) + 1);
-            prop_all.push_back(content);
-            // print_log("%s", content.to_string().c_str());
+            report_error(err, p_area);
+            return;
         }
+        print_property(store, ref, prop_count, changed);
+        return;
     }
-    if (p_bt->left != 0)
-    {
-        recursive(p_area, p_bt->left, file_name);
-    }
-    if (p_bt->right != 0)
-    {
-        recursive(p_area, p_bt->right, file_name);
-    }
-    if (p_bt->children != 0)
-    {
-        recursive(p_area, p_bt->children, file_name);
-    }
+    print_property(store, ref, prop_count, false);
 }
 
-bool dump_properties_from_file(const char *file_name)
+void print_area_plans(PropertyTransaction &transaction)
 {
-    prop_area *p_area = map_prop_area(file_name, false);
-    if (p_area == NULL)
+    for (auto &plan : transaction.area_plans())
     {
-        return false;
+        const char *context = plan.area->context().empty() ? plan.area->path().c_str() : plan.area->context().c_str();
+        int64_t headroom = (int64_t)plan.bytes_free - plan.need_bytes();
+        // a batch that doesn't fit always gets reported, even without -v
+        if (plan.fits() && !g_verbose_mode)
+            continue;
+        fprintf(plan.fits() ? stdout : stderr,
+                "area [%s]: %u prop_bt (%u bytes) %u prop_info (%u bytes), need %u free %u headroom %lld\n",
+                context, plan.new_nodes, plan.bt_bytes, plan.new_props, plan.info_bytes, plan.need_bytes(),
+                plan.bytes_free, (long long)headroom);
     }
-    recursive(p_area, 0, file_name);
-
-    return true;
 }
 
-int get_sdk_version()
+/**
+ * Applies a PropertyTransaction: nothing is written unless every property resolves and
+ * fits, and with journal_path the old values are saved there first. Every property
+ * written goes to recorder.
+ */
+int commit_transaction(PropertyStore &store, PropertyTransaction &transaction, uint32_t prop_count,
+                       const char *journal_path, TraceRecorder &recorder)
 {
-    static int sdk_version = 0;
-    if (sdk_version != 0)
+    recorder.start();
+    prop_error err = transaction.plan();
+    print_area_plans(transaction);
+    if (err != PROP_OK)
     {
-        return sdk_version;
+        fprintf(stderr, "[%s]: %s, nothing changed\n",
+                transaction.changes()[transaction.failed_index()].name.c_str(), prop_strerror(err));
+        return -1;
     }
-    char sdk_value[PROP_VALUE_MAX] = {0};
-    __system_property_get("ro.build.version.sdk", sdk_value);
-    if (strlen(sdk_value) > 0)
+    if (journal_path != NULL)
     {
-        sdk_version = atoi(sdk_value);
+        err = transaction.write_journal(journal_path);
+        if (err != PROP_OK)
+        {
+            fprintf(stderr, "can't write journal [%s]: %s, nothing changed\n", journal_path, strerror(errno));
+            return -1;
+        }
+    }
+    size_t changed = 0;
+    err = transaction.apply(&changed);
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "[%s]: %s", transaction.changes()[transaction.failed_index()].name.c_str(),
+                prop_strerror(err));
+        if (journal_path != NULL)
+            fprintf(stderr, ", use --rollback %s to undo", journal_path);
+        fprintf(stderr, "\n");
+        return -1;
     }
-    return sdk_version;
+    recorder.finish_batch(transaction.changes());
+    for (auto &change : transaction.changes())
+    {
+        PropertyRef ref;
+        if (store.get(change.name.c_str(), &ref) == PROP_OK)
+            print_property(store, ref, prop_count, change.effective);
+    }
+    if (g_verbose_mode)
+        print_log("%zu changed\n", changed);
+    return 0;
 }
 
 /**
- * 打印所有属性
- *  Android N之间所有属性是在/dev/__properties__文件中
- *  Android N上，每个security context对应一个文件，security context和属性前缀对应关系保存在/property_contexts文件中
+ * -c with a wildcard: all matches are collected from the read-only mappings and
+ * handed to set_counts(), so areas without a differing counter are never made writable.
  */
-void dump_all()
+int set_matching_counts(PropertyStore &store, const char *prop_name, uint32_t prop_count)
 {
-    prop_all.clear();
-    if (get_sdk_version() < ANDROID_N)
-    {
-        dump_properties_from_file(PROPERTIES_FILE);
-    }
-    else
+    std::vector<PropertyRef> refs;
     {
-        if (g_use_file)
+        PROP_STATS_PHASE(PHASE_FILTER);
+        std::string_view sv(prop_name);
+        for (AreaHandle &area : store)
         {
-            for (context_node *p_context = g_contexts; p_context != NULL; p_context = p_context->next)
+            prop_error err = area.map(false);
+            if (err != PROP_OK)
             {
-                char context_file[128] = PROPERTIES_FILE;
-                strcat(context_file, "/");
-                strcat(context_file, p_context->name);
-                if (g_need_security_context)
-                {
-                    g_current_security_context = (char *)p_context->name;
-                }
-                dump_properties_from_file(context_file);
+                report_error(err, &area);
+                continue;
             }
-        }
-        else
-        {
-            for (uint32_t i = 0; i < g_info.get_context_size(); i++)
+            for (PropertyRef ref : area)
             {
-                char context_file[128] = PROPERTIES_FILE;
-                strcat(context_file, "/");
-                strcat(context_file, g_info.get_context(i).c_str());
-                if (g_need_security_context)
-                {
-                    g_current_security_context = (char *)g_info.get_context(i).c_str();
-                }
-                dump_properties_from_file(context_file);
+                if (match_prop_name(sv, ref.name()))
+                    refs.push_back(ref);
             }
         }
+        std::sort(refs.begin(), refs.end(), [](const PropertyRef &a, const PropertyRef &b) {
+            return strcmp(a.name(), b.name()) < 0;
+        });
     }
-
-    return;
+    std::vector<bool> changed;
+    prop_error err = store.set_counts(refs, prop_count, &changed);
+    for (size_t i = 0; i < refs.size(); i++)
+        print_property(store, refs[i], prop_count, changed[i]);
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "%s!\n", prop_strerror(err));
+        return -1;
+    }
+    return 0;
 }
 
-void filter_all(const char *prop_name)
+/**
+ * --delete on the areas: a pattern is resolved with a dump first, names are
+ * copied since every removal changes the area they point into.
+ */
+static int run_delete(PropertyStore &store, const char *delete_name)
 {
-    if (prop_name == NULL || strlen(prop_name) < 2)
+    std::vector<std::string> names;
+    std::string_view sv(delete_name);
+    if (sv.starts_with("*") || sv.ends_with("*"))
     {
-        std::sort(prop_all.begin(), prop_all.end());
-        return;
+        dump_all(store);
+        filter_all(delete_name);
+        for (auto &p : prop_all)
+            names.emplace_back(p.name);
     }
-    std::string_view sv(prop_name);
-    std::vector<prop_content> vec;
-    for (auto &p : prop_all)
+    else
+    {
+        names.emplace_back(sv);
+    }
+    int result = 0;
+    for (auto &name : names)
     {
-        if (sv == "**" ||
-            (sv.starts_with("*") && p.name.ends_with(sv.substr(1))) ||
-            (sv.ends_with("*") && p.name.starts_with(sv.substr(0, sv.size() - 1))) ||
-            (sv.starts_with("*") && sv.ends_with("*") && p.name.find(sv.substr(1, sv.size() - 2)) != std::string::npos))
+        prop_error err = store.remove(name.c_str());
+        if (err == PROP_OK)
         {
-            // print_log("%s\n", p.to_string().c_str());
-            vec.push_back(p);
+            print_log("deleted [%s]\n", name.c_str());
+            continue;
         }
+        fprintf(stderr, "delete [%s]: %s\n", name.c_str(), prop_strerror(err));
+        result = -1;
     }
-    std::sort(vec.begin(), vec.end());
-    prop_all = vec;
-    return;
+    return result;
 }
 
-int cmp_prop_name(const char *one, uint8_t one_len, const char *two, uint8_t two_len)
+static void report_audit_error(PropAuditLog &audit, prop_error err)
 {
-    if (one_len < two_len)
-        return -1;
-    else if (one_len > two_len)
-        return 1;
-    else
-        return strncmp(one, two, one_len);
+    const char *reason = err == PROP_ERR_OPEN || err == PROP_ERR_MAP ? strerror(errno) : "not an audit ring of this build";
+    fprintf(stderr, "audit [%s]: %s\n", audit.path().c_str(), reason);
 }
 
- prop_info *find_prop_info(prop_area *area, const char *prop_name, bool need_add, bool need_confirm = true)
+// writes are recorded only with --audit FILE, and a FILE that can't be used stops the write
+static int attach_audit(PropertyStore &store, PropAuditLog &audit)
 {
-    if (area == NULL || strlen(prop_name) == 0)
+    prop_error err = audit.open(true);
+    if (err == PROP_OK)
     {
-        return NULL;
+        store.set_audit(&audit);
+        return 0;
     }
-    prop_bt *prev_bt = get_prop_bt(area, 0);
-    if (prev_bt->children == 0)
+    report_audit_error(audit, err);
+    return -1;
+}
+
+// --audit-show: the entries still in the ring, oldest first
+static int run_audit_show(PropAuditLog &audit)
+{
+    prop_error err = audit.open(false);
+    if (err != PROP_OK)
     {
-        return NULL;
+        report_audit_error(audit, err);
+        return -1;
     }
-    prop_bt *p_bt = get_prop_bt(area, prev_bt->children);
-    const char *remain_name = prop_name;
-    while (true)
+    std::vector<prop_audit_entry> entries;
+    size_t torn = 0;
+    audit.read(&entries, &torn);
+    PROP_STATS_PHASE(PHASE_OUTPUT);
+    for (auto &e : entries)
     {
-        const char *seq = strchr(remain_name, '.');
-        bool want_subtree = (seq != NULL);
-        uint8_t substr_size = want_subtree ? (seq - remain_name) : strlen(remain_name);
-
-        if (p_bt == NULL && need_add)
-        {
-            if (need_confirm) {
-                char ans;
-                printf("prop [%s] doesn't exist, create it? y*/n\n", prop_name);
-                ans = getchar();
-                if (ans == 'n' || ans == 'N')
-                    return NULL;
-                else
-                    p_bt = new_prop_bt(area, remain_name, substr_size, &prev_bt->children);
-            } else {
-                p_bt = new_prop_bt(area, remain_name, substr_size, &prev_bt->children);
-            }            
-        }
-
-        prop_bt *current = NULL;
-        while (p_bt != NULL)
-        {
-            int ret = cmp_prop_name(remain_name, substr_size, p_bt->name, p_bt->namelen);
-            if (ret == 0)
-            {
-                current = p_bt;
-                break;
-            }
-            else if (ret < 0)
-            {
-                if (p_bt->left == 0)
-                {
-                    if (need_add)
-                    {
-                        p_bt = new_prop_bt(area, remain_name, substr_size, &p_bt->left);
-                    }
-                    else
-                    {
-                        p_bt = NULL;
-                    }
-                }
-                else
-                {
-                    p_bt = get_prop_bt(area, p_bt->left);
-                }
-            }
-            else
-            {
-                if (p_bt->right == 0)
-                {
-                    if (need_add)
-                    {
-                        p_bt = new_prop_bt(area, remain_name, substr_size, &p_bt->right);
-                    }
-                    else
-                    {
-                        p_bt = NULL;
-                    }
-                }
-                else
-                {
-                    p_bt = get_prop_bt(area, p_bt->right);
-                }
-            }
-        }
-        if (current != NULL)
-        {
-            if (!want_subtree)
-            {
-                prop_info *info = NULL;
-                if (current->prop == 0)
-                {
-                    if (need_add)
-                    {
-                        info = new_prop_info(area, prop_name, strlen(prop_name), &current->prop);
-                    }
-                    else
-                    {
-                        info = NULL;
-                    }
-                }
-                else
-                {
-                    info = get_prop_info(area, current->prop);
-                }
-                return info;
-            }
-            else
-            {
-                remain_name = seq + 1;
-                if (current->children == 0)
-                {
-                    p_bt = NULL;
-                }
-                else
-                {
-                    p_bt = get_prop_bt(area, current->children);
-                }
-                prev_bt = current;
-            }
-        }
-        else
-        {
-            return NULL;
-        }
+        time_t sec = e.time_ns / 1000000000ull;
+        struct tm tm;
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime_r(&sec, &tm));
+        print_log("%s.%06u pid %u %s [%s]: [%s] -> [%s] serial 0x%08X -> 0x%08X\n", when,
+                  (unsigned)(e.time_ns % 1000000000ull / 1000), e.pid, prop_audit_op_name(e.op), e.name, e.old_value,
+                  e.new_value, e.old_serial, e.new_serial);
     }
-    return NULL;
+    if (torn != 0)
+        fprintf(stderr, "%zu entries skipped while being written\n", torn);
+    return 0;
 }
 
-void get_or_set_property_value_count(const char *prop_name, const char *prop_value, uint32_t prop_count, bool need_confirm)
+/**
+ * get/set/delete/dump on the persistent_properties file instead of the areas.
+ * Output matches prop_content::output(), there is no serial in the file.
+ */
+int run_persist(const char *persist_path, const char *prop_name, const char *prop_value, const char *delete_name)
 {
-    prop_area *p_area = NULL;
-    bool need_write = prop_value != NULL || prop_count != PROP_COUNT_MAX;
-    if (get_sdk_version() < ANDROID_N)
+    PersistentPropertyFile file(persist_path);
+    prop_error err = file.open();
+    if (err != PROP_OK)
     {
-        p_area = map_prop_area(PROPERTIES_FILE, need_write);
+        fprintf(stderr, "open file[%s] error[%d]:%s\n", persist_path, errno, strerror(errno));
+        return -1;
     }
-    else
+
+    if (delete_name != NULL)
     {
-        char context_file[128] = PROPERTIES_FILE;
-        strcat(context_file, "/");
-        if (g_use_file)
+        std::string_view sv(delete_name);
+        bool wildcard = sv.starts_with("*") || sv.ends_with("*");
+        std::vector<std::string> names;
+        for (auto &record : file)
         {
-            prefix_node *p_prefix = get_prefix_node(prop_name);
-            if (p_prefix == NULL || p_prefix->context == NULL)
-            {
-                fprintf(stderr, "can't find security context file!\n");
-                return;
-            }
-            strcat(context_file, p_prefix->context->name);
-            if (g_need_security_context)
-            {
-                g_current_security_context = p_prefix->context->name;
-            }
+            if (wildcard ? match_prop_name(sv, record.name) : record.name == sv)
+                names.emplace_back(record.name);
         }
-        else
+        size_t removed = 0;
+        if (!file.is_corrupt())
+            err = file.remove(names, &removed);
+        if (err == PROP_OK && !file.is_corrupt())
         {
-            std::string context_name = g_info.get_context(prop_name);
-            strcat(context_file, g_info.get_context(prop_name).c_str());
-            if (g_need_security_context)
-            {
-                g_current_security_context = (char *)context_name.c_str();
-            }
+            for (auto &name : names)
+                print_log("deleted [%s]\n", name.c_str());
         }
-
-        p_area = map_prop_area(context_file, need_write);
     }
-    prop_info *p_info = find_prop_info(p_area, prop_name, need_write, need_confirm);
-    if (p_info != NULL)
+    else if (prop_value != NULL)
     {
-        if (need_write)
-        {
-            if (p_info->update_value_count(prop_value, prop_count))
-            {
-                if (g_verbose_mode)
-                    print_log("set %s -> %s, valuelen %d count %d\n", prop_name, p_info->value, 
-                                p_info->serial >> 24, p_info->get_count());
-                else
-                    print_log("set ");
-            }
-        }
-        print_log("[%s]: [%s]", p_info->name, p_info->value);
-        if (p_info->get_count() || prop_count != PROP_COUNT_MAX || g_verbose_mode)
-            print_log(" count %d", p_info->get_count());            
-        if (g_verbose_mode)
-            print_log(" serial 0x%08X",  p_info->serial);
-        if (g_need_security_context)
+        err = file.set(prop_name, prop_value);
+        if (err == PROP_OK)
+            print_log("set [%s]: [%s]\n", prop_name, prop_value);
+    }
+    else
+    {
+        std::string_view sv(prop_name == NULL ? "**" : prop_name);
+        bool wildcard = sv.starts_with("*") || sv.ends_with("*");
+        std::vector<prop_content> props;
+        for (auto &record : file)
         {
-            print_log(" context: [%s]", get_security_context(p_info->name));
+            if (wildcard ? match_prop_name(sv, record.name) : record.name == sv)
+                props.push_back({record.name, record.value, "", 0});
         }
-        print_log("\n");
+        std::sort(props.begin(), props.end());
+        for (auto &p : props)
+            p.output();
     }
+
+    if (err == PROP_OK && file.is_corrupt())
+        err = PROP_ERR_CORRUPT;
+    if (err != PROP_OK)
+    {
+        fprintf(stderr, "[%s]: %s\n", persist_path, err == PROP_ERR_CORRUPT ? "malformed file" : prop_strerror(err));
+        return -1;
+    }
+    return 0;
 }
 
+enum
+{
+    OPT_ROOT = 256,
+    OPT_SERVE,
+    OPT_CLIENT,
+    OPT_BENCH,
+    OPT_CLIENTS,
+    OPT_REQUESTS,
+    OPT_JOURNAL,
+    OPT_ROLLBACK,
+    OPT_CREATE,
+    OPT_IMPORT,
+    OPT_PERSIST,
+    OPT_DELETE,
+    OPT_REUSE_FREE,
+    OPT_DIFF,
+    OPT_SUMMARY,
+    OPT_VERIFY,
+    OPT_CACHE,
+    OPT_WAIT,
+    OPT_TIMEOUT,
+    OPT_AUDIT,
+    OPT_AUDIT_SHOW,
+    OPT_READER_BENCH,
+    OPT_RECORD,
+    OPT_REPLAY,
+    OPT_PACE,
+    OPT_LS,
+    OPT_DEPTH,
+    OPT_GUARD,
+    OPT_INFO_BUILD,
+    OPT_INFO_RULE,
+    OPT_INFO_DROP,
+    OPT_CLONE,
+    OPT_COMMIT,
+};
+
+static bool g_stats_json = false;
+
+static void print_stats()
+{
+    fputs(prop_stats_format(g_stats_json).c_str(), stderr);
+}
+
+static const struct option long_options[] = {
+    {"root", required_argument, NULL, OPT_ROOT},
+    {"serve", required_argument, NULL, OPT_SERVE},
+    {"client", required_argument, NULL, OPT_CLIENT},
+    {"bench", required_argument, NULL, OPT_BENCH},
+    {"clients", required_argument, NULL, OPT_CLIENTS},
+    {"requests", required_argument, NULL, OPT_REQUESTS},
+    {"journal", required_argument, NULL, OPT_JOURNAL},
+    {"rollback", required_argument, NULL, OPT_ROLLBACK},
+    {"create", no_argument, NULL, OPT_CREATE},
+    {"import", no_argument, NULL, OPT_IMPORT},
+    {"persist", optional_argument, NULL, OPT_PERSIST},
+    {"delete", required_argument, NULL, OPT_DELETE},
+    {"reuse-free", no_argument, NULL, OPT_REUSE_FREE},
+    {"diff", no_argument, NULL, OPT_DIFF},
+    {"summary", optional_argument, NULL, OPT_SUMMARY},
+    {"verify", no_argument, NULL, OPT_VERIFY},
+    {"cache", required_argument, NULL, OPT_CACHE},
+    {"wait", required_argument, NULL, OPT_WAIT},
+    {"timeout", required_argument, NULL, OPT_TIMEOUT},
+    {"audit", required_argument, NULL, OPT_AUDIT},
+    {"audit-show", no_argument, NULL, OPT_AUDIT_SHOW},
+    {"reader-bench", optional_argument, NULL, OPT_READER_BENCH},
+    {"record", required_argument, NULL, OPT_RECORD},
+    {"replay", required_argument, NULL, OPT_REPLAY},
+    {"pace", required_argument, NULL, OPT_PACE},
+    {"ls", required_argument, NULL, OPT_LS},
+    {"depth", required_argument, NULL, OPT_DEPTH},
+    {"guard", required_argument, NULL, OPT_GUARD},
+    {"info-build", required_argument, NULL, OPT_INFO_BUILD},
+    {"info-rule", required_argument, NULL, OPT_INFO_RULE},
+    {"info-drop", required_argument, NULL, OPT_INFO_DROP},
+    {"clone", required_argument, NULL, OPT_CLONE},
+    {"commit", required_argument, NULL, OPT_COMMIT},
+    {"timing", optional_argument, NULL, 'T'},
+    {NULL, 0, NULL, 0},
+};
+
 static void usage()
 {
     fprintf(stderr,
-            "usage: system_properties [-h] [-c] [-l log_level] [-s] [-f] [-y] [-v] prop_name prop_value new_count*\n"
+            "usage: system_properties [-h] [-c] [-l log_level] [-s] [-f] [-y] [-v] [-T] prop_name prop_value new_count*\n"
             "  -h:                  display this help message\n"
             "  -c:                  set count\n"
             "  -l log_level:        console = 1(default) logcat = 2  console + logcat = 3\n"
             "  -s                   print security context(selabel)\n"
             "  -f                   read property_contexts files to get security context\n"
             "  -y                   auto confirm for new property\n"
-            "  -v                   verbose mode\n\n"
+            "  -v                   verbose mode\n"
+            "  -T[json], --timing[=json]\n"
+            "                       print phase timings and counters to stderr on exit\n"
+            "  --root DIR           use the areas under DIR instead of " PROPERTIES_FILE "\n"
+            "  --serve SOCKET       keep areas mapped and answer queries on a unix socket\n"
+            "  --client SOCKET      send prop_name (get/wildcard dump, or -c count) to a --serve daemon\n"
+            "  --bench SOCKET       load test a --serve daemon with gets of the props matching prop_name\n"
+            "  --clients N          concurrent connections for --bench (default 4)\n"
+            "  --requests N         total requests for --bench (default 100000)\n"
+            "  --journal FILE       set value/count as one transaction, saving old values to FILE first\n"
+            "  --rollback FILE      restore the values saved in a --journal FILE\n"
+            "  --create name=value...  create all listed properties or none, reporting area headroom\n"
+            "  --import FILE...     apply build.prop style files, writing only values that differ\n"
+            "  --persist[=FILE]     get/set/dump " PERSISTENT_PROPERTY_FILE " (or FILE) instead of the areas\n"
+            "  --delete NAME        delete a property or wildcard pattern from its area\n"
+            "  --reuse-free         with --root: put deleted bytes on a free list that later creations use\n"
+            "  --diff A B           compare two property sets: \"live\", a --root image or a saved dump\n"
+            "  --summary[=binary]   counter/length statistics per context and prefix, one JSON line or a binary record\n"
+            "  --verify             check every property sits in the area of its context, report duplicates and\n"
+            "                       missing or unlisted area files\n"
+            "  --cache FILE         wildcard dumps re-read only the areas changed since the dump saved in FILE\n"
+            "  --wait NAME [VALUE]  block until NAME has VALUE (or any non-empty value), woken by property changes\n"
+            "  --timeout MS         give up --wait after MS milliseconds, exit code 1 (--guard: stop after MS)\n"
+            "  --audit FILE         record every write in the ring FILE, nothing is recorded without it\n"
+            "  --audit-show         print the writes recorded in the --audit ring, oldest first (default\n"
+            "                       " PROP_AUDIT_FILE ")\n"
+            "  --reader-bench[=N]   time N bionic-style find+read lookups per area (default 100000), Zipf-distributed\n"
+            "  --record FILE        append each get/set/dump/count/delete of this run with its timing to FILE\n"
+            "  --replay FILE        re-run a --record FILE against --root, reporting latency per operation\n"
+            "  --pace X             replay at X times the recorded pace (default 0: back to back)\n"
+            "  --ls PREFIX          list the name segments under PREFIX (\"\" for the top) with property counts\n"
+            "  --depth N            levels shown by --ls (default 1, 0 for all)\n"
+            "  --guard PATTERN=COUNT  keep the counters of matching props at COUNT, rescanning areas when they\n"
+            "                       change (repeatable, runs until killed or --timeout MS)\n"
+            "  --info-build OUT [FILE...]  write a property_info image to OUT from property_contexts FILEs,\n"
+            "                       or from the --root image with the --info-rule/--info-drop edits\n"
+            "  --info-rule LINE     add or replace a \"name context [exact|prefix] [type]\" rule (repeatable)\n"
+            "  --info-drop NAME     remove the rules for NAME, \"a.b.\" for the node rule (repeatable)\n"
+            "  --clone DEST         copy the areas and property_info into DEST, recording each area's serial\n"
+            "  --commit SRC         write back the areas changed in the --clone SRC, refused if the live ones moved\n\n"
+            "socket names starting with '@' are in the abstract namespace\n"
             "use leading/trailing '*' for wildcard match, or \"all\" to match all props\n");
 }
 
@@ -662,18 +627,51 @@ int main(int argc, char *argv[])
     char *prop_value = NULL;
     uint32_t prop_count = PROP_COUNT_MAX;
     bool need_confirm = true;
+    bool use_file = false;
+    const char *root = PROPERTIES_FILE;
+    const char *serve_path = NULL;
+    const char *client_path = NULL;
+    const char *bench_path = NULL;
+    int bench_clients = 4;
+    int bench_requests = 100000;
+    const char *journal_path = NULL;
+    const char *rollback_path = NULL;
+    bool create_list = false;
+    bool import_files = false;
+    const char *persist_path = NULL;
+    const char *delete_name = NULL;
+    bool reuse_free = false;
+    bool diff_sides = false;
+    const char *summary_format = NULL;
+    bool verify_areas = false;
+    const char *cache_path = NULL;
+    const char *wait_name = NULL;
+    int wait_timeout = -1;
+    const char *audit_path = NULL;
+    bool audit_show = false;
+    int reader_lookups = 0;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    double replay_pace = 0;
+    const char *ls_prefix = NULL;
+    int ls_depth = LS_DEFAULT_DEPTH;
+    std::vector<guard_rule> guard_rules;
+    const char *info_out = NULL;
+    std::vector<const char *> info_rules;
+    std::vector<const char *> info_drops;
+    const char *clone_path = NULL;
+    const char *commit_path = NULL;
 
     for (;;)
     {
-        int option_index = 0;
-        int ic = getopt(argc, argv, "hvl:c:sf");
+        int ic = getopt_long(argc, argv, "hvl:c:sfyT::", long_options, NULL);
         if (ic < 0)
         {
             if (optind < argc)
             {
                 prop_name = argv[optind];
                 if (strncmp(prop_name, "all", PROP_NAME_MAX) == 0)
-                    prop_name =  strdup("**");;
+                    prop_name = (char *)g_arena.copy("**").data();
             }
             if (optind + 1 < argc)
             {
@@ -700,7 +698,7 @@ int main(int argc, char *argv[])
             g_need_security_context = true;
             break;
         case 'f':
-            g_use_file = true;
+            use_file = true;
             break;
         case 'y':
             need_confirm = false;
@@ -708,21 +706,277 @@ int main(int argc, char *argv[])
         case 'v':
             g_verbose_mode = true;
             break;
+        case 'T':
+            // -Tjson or --timing=json, the optional argument has to be attached
+            if (optarg != NULL && strcmp(optarg, "json") != 0)
+            {
+                usage();
+                return -1;
+            }
+            g_stats_json = optarg != NULL;
+            if (!g_prop_stats.enabled)
+            {
+                prop_stats_enable();
+                atexit(print_stats);
+            }
+            break;
+        case OPT_ROOT:
+            root = optarg;
+            break;
+        case OPT_SERVE:
+            serve_path = optarg;
+            break;
+        case OPT_CLIENT:
+            client_path = optarg;
+            break;
+        case OPT_BENCH:
+            bench_path = optarg;
+            break;
+        case OPT_CLIENTS:
+            bench_clients = atoi(optarg);
+            break;
+        case OPT_REQUESTS:
+            bench_requests = atoi(optarg);
+            break;
+        case OPT_JOURNAL:
+            journal_path = optarg;
+            break;
+        case OPT_ROLLBACK:
+            rollback_path = optarg;
+            break;
+        case OPT_CREATE:
+            create_list = true;
+            break;
+        case OPT_IMPORT:
+            import_files = true;
+            break;
+        case OPT_PERSIST:
+            persist_path = optarg != NULL ? optarg : PERSISTENT_PROPERTY_FILE;
+            break;
+        case OPT_DELETE:
+            delete_name = optarg;
+            break;
+        case OPT_REUSE_FREE:
+            reuse_free = true;
+            break;
+        case OPT_DIFF:
+            diff_sides = true;
+            break;
+        case OPT_SUMMARY:
+            summary_format = optarg != NULL ? optarg : "json";
+            if (strcmp(summary_format, "json") != 0 && strcmp(summary_format, "binary") != 0)
+            {
+                usage();
+                return -1;
+            }
+            break;
+        case OPT_VERIFY:
+            verify_areas = true;
+            break;
+        case OPT_CACHE:
+            cache_path = optarg;
+            break;
+        case OPT_WAIT:
+            wait_name = optarg;
+            break;
+        case OPT_TIMEOUT:
+            wait_timeout = atoi(optarg);
+            break;
+        case OPT_AUDIT:
+            audit_path = optarg;
+            break;
+        case OPT_AUDIT_SHOW:
+            audit_show = true;
+            break;
+        case OPT_RECORD:
+            record_path = optarg;
+            break;
+        case OPT_REPLAY:
+            replay_path = optarg;
+            break;
+        case OPT_PACE:
+            replay_pace = atof(optarg);
+            break;
+        case OPT_GUARD:
+        {
+            const char *eq = strrchr(optarg, '=');
+            if (eq == NULL || eq == optarg || eq[1] == '\0')
+            {
+                usage();
+                return -1;
+            }
+            guard_rules.push_back({std::string(optarg, eq - optarg), (uint32_t)atoi(eq + 1) & PROP_COUNT_MAX});
+            break;
+        }
+        case OPT_INFO_BUILD:
+            info_out = optarg;
+            break;
+        case OPT_INFO_RULE:
+            info_rules.push_back(optarg);
+            break;
+        case OPT_INFO_DROP:
+            info_drops.push_back(optarg);
+            break;
+        case OPT_CLONE:
+            clone_path = optarg;
+            break;
+        case OPT_COMMIT:
+            commit_path = optarg;
+            break;
+        case OPT_LS:
+            ls_prefix = optarg;
+            break;
+        case OPT_DEPTH:
+            ls_depth = atoi(optarg);
+            if (ls_depth < 0)
+            {
+                usage();
+                return -1;
+            }
+            break;
+        case OPT_READER_BENCH:
+            reader_lookups = optarg != NULL ? atoi(optarg) : READER_BENCH_LOOKUPS;
+            if (reader_lookups <= 0)
+            {
+                usage();
+                return -1;
+            }
+            break;
         default:
             usage();
             return -1;
         }
     }
 
+    // any process may still read freed bytes through a prop_info pointer it cached, so only in a copy
+    if (reuse_free && strcmp(root, PROPERTIES_FILE) == 0)
+    {
+        fprintf(stderr, "--reuse-free needs --root with a copy of the areas\n");
+        return -1;
+    }
+
+    PropAuditLog audit(audit_path != NULL ? audit_path : PROP_AUDIT_FILE);
+    bool use_audit = audit_path != NULL;
+    if (audit_show)
+        return run_audit_show(audit);
+
+    if (diff_sides)
+    {
+        if (optind + 2 != argc)
+        {
+            usage();
+            return -1;
+        }
+        return run_diff(argv[optind], argv[optind + 1], use_file);
+    }
+
+    if (info_out != NULL)
+        return run_info_build(info_out, (std::string(root) + "/property_info").c_str(), argv + optind, argc - optind,
+                              info_rules, info_drops);
+
+    TraceRecorder recorder(record_path);
+    if (create_list || import_files)
+    {
+        if (optind >= argc)
+        {
+            usage();
+            return -1;
+        }
+        if (geteuid() != 0 && strcmp(root, PROPERTIES_FILE) == 0)
+        {
+            fprintf(stderr, "set property value/count need root first!\n");
+            return -1;
+        }
+        PropertyStore store(root);
+        if (store.open(use_file) != PROP_OK)
+        {
+            fprintf(stderr, "can't find any property area!\n");
+            return -1;
+        }
+        if (use_audit && attach_audit(store, audit) != 0)
+            return -1;
+        store.set_reuse_free(reuse_free);
+        if (import_files)
+            return run_import(store, argv + optind, argc - optind, prop_count, need_confirm, journal_path, recorder);
+        PropertyTransaction transaction(store);
+        for (int i = optind; i < argc; i++)
+        {
+            std::string name(argv[i]);
+            size_t eq = name.find('=');
+            std::string value = eq == std::string::npos ? "" : name.substr(eq + 1);
+            name = name.substr(0, eq);
+            transaction.add(name.c_str(), value.c_str(), prop_count, true);
+        }
+        return commit_transaction(store, transaction, prop_count, journal_path, recorder);
+    }
+
+    if (replay_path != NULL)
+    {
+        // a replay writes whatever the trace wrote, so only into a copy
+        if (strcmp(root, PROPERTIES_FILE) == 0)
+        {
+            fprintf(stderr, "--replay needs --root with a copy of the areas\n");
+            return -1;
+        }
+        PropertyStore store(root);
+        if (store.open(use_file) != PROP_OK)
+        {
+            fprintf(stderr, "can't find any property area!\n");
+            return -1;
+        }
+        store.set_reuse_free(reuse_free);
+        return run_replay(store, replay_path, replay_pace);
+    }
+
+    if (clone_path != NULL || commit_path != NULL)
+    {
+        if (commit_path != NULL && geteuid() != 0 && strcmp(root, PROPERTIES_FILE) == 0)
+        {
+            fprintf(stderr, "set property value/count need root first!\n");
+            return -1;
+        }
+        PropertyStore store(root);
+        if (store.open(use_file) != PROP_OK)
+        {
+            fprintf(stderr, "can't find any property area!\n");
+            return -1;
+        }
+        return clone_path != NULL ? run_clone(store, clone_path) : run_commit(store, commit_path);
+    }
+
+    if (summary_format != NULL || verify_areas || wait_name != NULL || reader_lookups > 0 || ls_prefix != NULL)
+    {
+        PropertyStore store(root);
+        if (store.open(use_file) != PROP_OK)
+        {
+            fprintf(stderr, "can't find any property area!\n");
+            return -1;
+        }
+        if (wait_name != NULL)
+            return run_wait(store, wait_name, optind < argc ? argv[optind] : NULL, wait_timeout);
+        if (verify_areas)
+            return run_verify(store);
+        if (reader_lookups > 0)
+            return run_reader_bench(store, reader_lookups);
+        if (ls_prefix != NULL)
+            return run_ls(store, ls_prefix, ls_depth);
+        return run_summary(store, strcmp(summary_format, "binary") == 0);
+    }
+
+    if (client_path != NULL)
+        return run_client(client_path, prop_name, prop_count);
+    if (bench_path != NULL)
+        return run_bench(bench_path, prop_name, bench_clients, bench_requests);
+
     if (prop_name == NULL)
     {
         multi_prop = true;
         prop_count = PROP_COUNT_MAX; // disable empty name for setting count for all. use wildcard.
     }
-    else
+    else if (serve_path == NULL)
     {
         std::string_view sv(prop_name);
-        if (sv.starts_with(".") || sv.ends_with(".") || sv.find_first_of("*.") == std::string::npos)
+        if (!prop_name_valid(sv) || sv.find_first_of("*.") == std::string::npos)
         {
             fprintf(stderr, "Invalid property name!\n");
             return -1;
@@ -731,71 +985,135 @@ int main(int argc, char *argv[])
             multi_prop = true;
     }
 
-    if (prop_value != NULL || prop_count != PROP_COUNT_MAX)
+    if (prop_value != NULL && strlen(prop_value) >= PROP_VALUE_MAX)
+    // https://github.com/liwugang/android_properties/blob/master/jni/system_properties.cpp#L605
+    // as in original code, removed to restrict all prop values less than PROP_VALUE_MAX.
+    //&& (strlen(prop_name) < strlen("ro.") || strncmp(prop_name, "ro.", strlen("ro.")) != 0))
     {
-        std::string_view sv(prop_name);
-        if (prop_value != NULL && strlen(prop_value) >= PROP_VALUE_MAX)
-        // https://github.com/liwugang/android_properties/blob/master/jni/system_properties.cpp#L605
-        // as in original code, removed to restrict all prop values less than PROP_VALUE_MAX.
-        //&& (strlen(prop_name) < strlen("ro.") || strncmp(prop_name, "ro.", strlen("ro.")) != 0))
+        fprintf(stderr, "prop_value[%s] is too long, need less %d\n", prop_value, PROP_VALUE_MAX);
+        return -1;
+    }
+
+    if (persist_path != NULL)
+    {
+        if (prop_value != NULL && multi_prop)
         {
-            fprintf(stderr, "prop_value[%s] is too long, need less %d\n", prop_value, PROP_VALUE_MAX);
+            fprintf(stderr, "Invalid property name!\n");
             return -1;
         }
+        return run_persist(persist_path, prop_name, prop_value, delete_name);
+    }
+    bool need_write = prop_value != NULL || prop_count != PROP_COUNT_MAX || rollback_path != NULL ||
+                      delete_name != NULL || !guard_rules.empty();
+    if (need_write && serve_path == NULL && geteuid() != 0 && strcmp(root, PROPERTIES_FILE) == 0)
+    {
+        fprintf(stderr, "set property value/count need root first!\n");
+        return -1;
+    }
 
-        if (geteuid() != 0)
+    PropertyStore store(root);
+    if (store.open(use_file) != PROP_OK)
+    {
+        fprintf(stderr, "can't find any property area!\n");
+        return -1;
+    }
+
+    if (use_audit && (need_write || serve_path != NULL) && attach_audit(store, audit) != 0)
+        return -1;
+    store.set_reuse_free(reuse_free);
+
+    if (serve_path != NULL)
+        return run_server(store, serve_path);
+    if (!guard_rules.empty())
+        return run_guard(store, guard_rules, wait_timeout);
+
+    if (rollback_path != NULL)
+    {
+        size_t restored = 0, skipped = 0;
+        std::vector<prop_change> undone;
+        recorder.start();
+        prop_error err = PropertyTransaction::rollback(store, rollback_path, &restored, &skipped, &undone);
+        for (auto &change : undone)
+            recorder.finish(change.create ? TRACE_DELETE : TRACE_SET, change.name.c_str(),
+                            change.create ? NULL : change.value.c_str(), PROP_COUNT_MAX);
+        print_log("restored %zu skipped %zu\n", restored, skipped);
+        if (err != PROP_OK)
         {
-            fprintf(stderr, "set property value/count need root first!\n");
+            fprintf(stderr, "rollback [%s]: %s\n", rollback_path, prop_strerror(err));
             return -1;
         }
+        return 0;
+    }
+
+    if (delete_name != NULL)
+    {
+        recorder.start();
+        int ret = run_delete(store, delete_name);
+        recorder.finish(TRACE_DELETE, delete_name, NULL, PROP_COUNT_MAX);
+        return ret;
     }
 
-    if (g_use_file || !g_info.is_valid())
+    if (journal_path != NULL && need_write)
     {
-        g_use_file = true;
-        // https://cs.android.com/android/platform/superproject/main/+/main:system/core/init/property_service.cpp
-        if (get_sdk_version() >= ANDROID_O)
+        std::vector<std::string> names;
+        bool create = false;
+        if (multi_prop)
         {
-            if (access("/system/etc/selinux/plat_property_contexts", R_OK) != -1)
-            {
-                initialize_contexts("/system/etc/selinux/plat_property_contexts");
-                initialize_contexts("/vendor/etc/selinux/nonplat_property_contexts");
-                initialize_contexts("/vendor/etc/selinux/vendor_property_contexts");   // name changed in android P
-                initialize_contexts("/product/etc/selinux/product_property_contexts"); // Add in Android Q
-                initialize_contexts("/odm/etc/selinux/odm_property_contexts");
-                initialize_contexts("/system_ext/etc/selinux/system_ext_property_contexts"); // Add in Android R
-            }
-            else
-            {
-                initialize_contexts("/plat_property_contexts");
-                initialize_contexts("/nonplat_property_contexts");
-            }
+            dump_all(store);
+            filter_all(prop_name);
+            for (auto &p : prop_all)
+                names.emplace_back(p.name);
         }
         else
         {
-            initialize_contexts("/property_contexts");
+            PropertyRef ref;
+            if (store.get(prop_name, &ref) == PROP_ERR_NOT_FOUND)
+            {
+                if (need_confirm)
+                {
+                    printf("prop [%s] doesn't exist, create it? y*/n\n", prop_name);
+                    char ans = getchar();
+                    if (ans == 'n' || ans == 'N')
+                        return 0;
+                }
+                create = true;
+            }
+            names.push_back(prop_name);
         }
+        PropertyTransaction transaction(store);
+        for (auto &name : names)
+            transaction.add(name.c_str(), multi_prop ? NULL : prop_value, prop_count, create);
+        return commit_transaction(store, transaction, prop_count, journal_path, recorder);
     }
 
-
+    recorder.start();
     if (multi_prop)
     {
-        dump_all();
+        if (prop_count != PROP_COUNT_MAX)
+        {
+            int ret = set_matching_counts(store, prop_name, prop_count);
+            recorder.finish(TRACE_COUNT, prop_name, NULL, prop_count);
+            return ret;
+        }
+        DumpCache cache(cache_path != NULL ? cache_path : "");
+        if (cache_path != NULL)
+            cache.load(store);
+        dump_all(store, cache_path != NULL ? &cache : NULL);
         filter_all(prop_name);
+        PROP_STATS_PHASE(PHASE_OUTPUT);
         for (auto &p : prop_all)
         {
-            if (prop_count != PROP_COUNT_MAX)
-                get_or_set_property_value_count(p.name.c_str(), NULL, prop_count, need_confirm);
-            else
-                //print_log("%s\n", p.to_string().c_str());
-                p.output();
+            //print_log("%s\n", p.to_string().c_str());
+            p.output();
         }
+        recorder.finish(TRACE_DUMP, prop_name, NULL, PROP_COUNT_MAX);
     }
     else
     {
-        get_or_set_property_value_count(prop_name, prop_value, prop_count, need_confirm);
+        get_or_set_property_value_count(store, prop_name, prop_value, prop_count, need_confirm);
+        bool is_set = prop_value != NULL || prop_count != PROP_COUNT_MAX;
+        recorder.finish(is_set ? TRACE_SET : TRACE_GET, prop_name, prop_value, prop_count);
     }
 
-    cleanup_resource();
     return 0;
 }
@@ -0,0 +1,69 @@
+#!/bin/sh
+# usage: guard_test.sh BINARY
+#
+# --guard against a generated root, with counters changed the way init does
+# it: the prop_info is written, then only the properties_serial word moves
+# and its waiters are woken, no per-area serial. Every change must be put
+# back, including one in an area the guard had already fixed.
+set -u
+BIN=$1
+HERE=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+ROOT=$TMP/root
+python3 "$HERE/mkfixture.py" "$ROOT" "$HERE/fixture.txt" || exit 1
+
+# what init does after a property write: properties_serial + 1, FUTEX_WAKE on it
+init_notify()
+{
+    python3 - "$ROOT/properties_serial" <<'EOF'
+import ctypes, mmap, os, struct, sys
+SYS_FUTEX = {"x86_64": 202, "aarch64": 98, "armv7l": 240, "i686": 240}[os.uname().machine]
+with open(sys.argv[1], "r+b") as f:
+    area = mmap.mmap(f.fileno(), 0)
+    struct.pack_into("<I", area, 4, (struct.unpack_from("<I", area, 4)[0] + 1) & 0xFFFFFFFF)
+    word = ctypes.c_uint32.from_buffer(area, 4)
+    ctypes.CDLL(None, use_errno=True).syscall(SYS_FUTEX, ctypes.byref(word), 1, 0x7FFFFFFF, None, None, 0)
+    del word
+    area.close()
+EOF
+}
+
+fail=0
+count_of()
+{
+    "$BIN" --root "$ROOT" "$1" | sed -n 's/.*count: \([0-9]*\)$/\1/p'
+}
+expect_count()
+{
+    got=$(count_of "$1")
+    if [ "${got:-0}" -ne "$2" ]; then
+        echo "FAIL: $3: [$1] count ${got:-0}, want $2"
+        fail=1
+    fi
+}
+
+timeout 20 "$BIN" --root "$ROOT" --guard 'sys.usb.*=0' --guard 'vendor.*=0' --timeout 3000 >"$TMP/guard" 2>&1 &
+guard=$!
+sleep 0.5
+expect_count sys.usb.config 0 "first pass"
+expect_count vendor.gpu.driver 0 "first pass"
+
+# the same area again, then another one; our writes move no serial, init_notify stands in for init
+"$BIN" --root "$ROOT" -c 7 sys.usb.config >/dev/null
+init_notify
+sleep 0.5
+expect_count sys.usb.config 0 "change in an area already fixed"
+"$BIN" --root "$ROOT" -c 5 vendor.audio.driver >/dev/null
+init_notify
+sleep 0.5
+expect_count vendor.audio.driver 0 "change in another area"
+
+wait "$guard"
+if ! grep -q "fixed \[vendor.audio.driver\] count 5 -> 0" "$TMP/guard"; then
+    echo "FAIL: guard printed: $(cat "$TMP/guard")"
+    fail=1
+fi
+
+[ $fail -eq 0 ] && echo "guard_test: ok"
+exit $fail
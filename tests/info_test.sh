@@ -0,0 +1,26 @@
+#!/bin/sh
+# usage: info_test.sh PROPERTY_INFO_TEST [SEEDS]
+#
+# Runs the property_info_test binary (the property_info_test module of
+# jni/Android.mk) on SEEDS images generated by mkinfo.py, each with the
+# property_contexts it was built from: the builder must give back the same
+# bytes and batch_resolver the same contexts as a plain lookup.
+set -u
+BIN=$1
+SEEDS=${2:-20}
+HERE=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail=0
+for seed in $(seq 1 "$SEEDS"); do
+    python3 "$HERE/mkinfo.py" "$TMP/property_info" "$TMP/property_contexts" "$seed" || exit 1
+    if ! "$BIN" "$TMP/property_info" "$TMP/property_contexts" >"$TMP/out" 2>&1; then
+        echo "FAIL: seed $seed:"
+        cat "$TMP/out"
+        fail=1
+    fi
+done
+
+[ $fail -eq 0 ] && echo "info_test: ok ($SEEDS images)"
+exit $fail
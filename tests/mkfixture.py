@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""Builds a split property root for --root from a plain text list.
+
+usage: mkfixture.py DIR FILE
+
+FILE has one entry per line, blank lines and '#' comments are skipped:
+
+    CONTEXT NAME [VALUE [COUNT]]    a property in the area file DIR/CONTEXT
+    prefix NAME CONTEXT             a property_info prefix rule
+
+Every context gets an area file, the trie laid out the way bionic's
+prop_area::find_property() builds it. DIR/property_info maps the prefixes
+(root default: the first context), and DIR/properties_serial is an empty
+area, as init creates it.
+"""
+
+import os
+import struct
+import sys
+
+AREA_SIZE = 128 * 1024
+HEADER_SIZE = 128
+DATA_SIZE = AREA_SIZE - HEADER_SIZE
+PROP_AREA_MAGIC = 0x504F5250
+PROP_AREA_VERSION = 0xFC6ED0AB
+PROP_VALUE_MAX = 92
+
+# prop_bt words after namelen/reserved
+BT_PROP, BT_LEFT, BT_RIGHT, BT_CHILDREN = 1, 2, 3, 4
+
+
+def align4(n):
+    return (n + 3) & ~3
+
+
+class Area:
+    def __init__(self):
+        self.buf = bytearray(AREA_SIZE)
+        # the root prop_bt, nameless, like the prop_area constructor leaves it
+        self.used = 20
+
+    def alloc(self, size):
+        off = self.used
+        self.used += align4(size)
+        if self.used > DATA_SIZE:
+            raise SystemExit("area full")
+        return off
+
+    def word(self, off, i):
+        return struct.unpack_from("<I", self.buf, HEADER_SIZE + off + 4 * i)[0]
+
+    def set_word(self, off, i, value):
+        struct.pack_into("<I", self.buf, HEADER_SIZE + off + 4 * i, value)
+
+    def new_bt(self, name):
+        off = self.alloc(20 + len(name) + 1)
+        p = HEADER_SIZE + off
+        self.buf[p] = len(name)
+        self.buf[p + 20:p + 20 + len(name)] = name
+        return off
+
+    def bt_name(self, off):
+        p = HEADER_SIZE + off
+        return bytes(self.buf[p + 20:p + 20 + self.buf[p]])
+
+    def add(self, name, value, count):
+        if len(value) >= PROP_VALUE_MAX:
+            raise SystemExit("value too long: %s" % name.decode())
+        parent = 0
+        for segment in name.split(b"."):
+            link = (parent, BT_CHILDREN)
+            cur = self.word(*link)
+            while True:
+                if cur == 0:
+                    cur = self.new_bt(segment)
+                    self.set_word(link[0], link[1], cur)
+                    break
+                other = self.bt_name(cur)
+                # shorter segments first, then bytes, like cmp_prop_name()
+                cmp = (len(segment) > len(other)) - (len(segment) < len(other)) or (segment > other) - (segment < other)
+                if cmp == 0:
+                    break
+                link = (cur, BT_LEFT if cmp < 0 else BT_RIGHT)
+                cur = self.word(*link)
+            parent = cur
+        off = self.alloc(4 + PROP_VALUE_MAX + len(name) + 1)
+        p = HEADER_SIZE + off
+        struct.pack_into("<I", self.buf, p, (len(value) << 24) | (count & 0xFFFF))
+        self.buf[p + 4:p + 4 + len(value)] = value
+        self.buf[p + 4 + PROP_VALUE_MAX:p + 4 + PROP_VALUE_MAX + len(name)] = name
+        self.set_word(parent, BT_PROP, off)
+
+    def save(self, path):
+        struct.pack_into("<IIII", self.buf, 0, self.used, 0, PROP_AREA_MAGIC, PROP_AREA_VERSION)
+        with open(path, "wb") as f:
+            f.write(self.buf)
+
+
+def write_property_info(path, contexts, prefixes):
+    """A property_info with only root prefixes; contexts[0] is the root default."""
+    out = bytearray(24)
+
+    def add_string(s):
+        off = len(out)
+        out.extend(s + b"\0")
+        while len(out) % 4:
+            out.append(0)
+        return off
+
+    context_strings = [add_string(c) for c in contexts]
+    type_string = add_string(b"string")
+    contexts_off = len(out)
+    out.extend(struct.pack("<I", len(contexts)))
+    for off in context_strings:
+        out.extend(struct.pack("<I", off))
+    types_off = len(out)
+    out.extend(struct.pack("<II", 1, type_string))
+    root_name = add_string(b"")
+    root_entry = len(out)
+    out.extend(struct.pack("<IIII", root_name, 0, 0, 0))
+    entries = []
+    for prefix, index in sorted(prefixes, key=lambda p: -len(p[0])):
+        name = add_string(prefix)
+        entries.append(len(out))
+        out.extend(struct.pack("<IIII", name, len(prefix), index, 0))
+    prefix_array = len(out)
+    for off in entries:
+        out.extend(struct.pack("<I", off))
+    root = len(out)
+    out.extend(struct.pack("<IIIIIII", root_entry, 0, 0, len(entries), prefix_array, 0, 0))
+    struct.pack_into("<IIIIII", out, 0, 1, 1, len(out), contexts_off, types_off, root)
+    with open(path, "wb") as f:
+        f.write(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        raise SystemExit(__doc__.split("\n\n")[1])
+    root, listing = sys.argv[1], sys.argv[2]
+    os.makedirs(root, exist_ok=True)
+    areas, contexts, prefixes = {}, [], []
+    with open(listing) as f:
+        for line in f:
+            fields = line.split()
+            if not fields or fields[0].startswith("#"):
+                continue
+            if fields[0] == "prefix":
+                context = fields[2]
+                if context not in contexts:
+                    contexts.append(context)
+                prefixes.append((fields[1].encode(), contexts.index(context)))
+                continue
+            context, name = fields[0], fields[1]
+            value = fields[2] if len(fields) > 2 else ""
+            count = int(fields[3]) if len(fields) > 3 else 0
+            if context not in contexts:
+                contexts.append(context)
+            areas.setdefault(context, Area()).add(name.encode(), value.encode(), count)
+    for context in contexts:
+        areas.setdefault(context, Area()).save(os.path.join(root, context))
+    Area().save(os.path.join(root, "properties_serial"))
+    write_property_info(os.path.join(root, "property_info"), [c.encode() for c in contexts], prefixes)
+
+
+if __name__ == "__main__":
+    main()
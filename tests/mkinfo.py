@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Writes a random property_contexts file and the property_info image AOSP's
+property_info_serializer builds from it.
+
+usage: mkinfo.py INFO CONTEXTS [SEED]
+
+The rules are drawn from a small set of name segments, so names share nodes,
+prefixes and exact matches the way real contexts files do. The image is laid
+out like TrieSerializer: header, sorted context and type tables, then each
+node followed by its entry, its prefixes longest first, its exact matches and
+children sorted by name, and its children. Equal-length prefixes keep the
+order of the file, like PropertyInfoBuilder.
+"""
+
+import random
+import struct
+import sys
+
+DEFAULT_CONTEXT = "u:object_r:default_prop:s0"
+DEFAULT_TYPE = "string"
+SEGMENTS = ["ro", "boot", "persist", "sys", "vendor", "x", "build", "version", "a", "gpu", "usb"]
+CONTEXTS = ["u:object_r:c%d_prop:s0" % i for i in range(8)]
+TYPES = [None, None, "string", "bool", "int", "uint", "double", "size", "enum on off", "enum 0 1 2"]
+RULES = 200
+
+
+class Node:
+    def __init__(self, name):
+        self.name = name
+        self.context = None
+        self.type = None
+        self.prefixes = []
+        self.exact = []
+        self.children = {}
+
+    def child(self, name):
+        return self.children.setdefault(name, Node(name))
+
+
+def random_rules(rng):
+    rules, seen = [], set()
+    for _ in range(RULES):
+        name = ".".join(rng.choice(SEGMENTS) for _ in range(1 + rng.randrange(4)))
+        exact = rng.random() < 0.5
+        if not exact:
+            r = rng.random()
+            if r < 0.5:
+                name += "."
+            elif r < 0.7 and len(name) > 1 and name[-2] != ".":
+                name = name[:-1]
+        if (name, exact) in seen:
+            continue
+        seen.add((name, exact))
+        rules.append((name, rng.choice(CONTEXTS), exact, rng.choice(TYPES)))
+    return rules
+
+
+def build_trie(rules):
+    root = Node("root")
+    root.context, root.type = DEFAULT_CONTEXT, DEFAULT_TYPE
+    for name, context, exact, type_ in rules:
+        parts = name.split(".")
+        node = root
+        for part in parts[:-1]:
+            node = node.child(part)
+        if not exact and name.endswith("."):
+            node.context, node.type = context, type_
+        else:
+            (node.exact if exact else node.prefixes).append((parts[-1], context, type_))
+    return root
+
+
+class Image:
+    def __init__(self, contexts, types):
+        self.buf = bytearray()
+        self.contexts = sorted(contexts)
+        self.types = sorted(types)
+
+    def alloc(self, size):
+        off = len(self.buf)
+        self.buf.extend(b"\0" * ((size + 3) & ~3))
+        return off
+
+    def add_string(self, s):
+        data = s.encode()
+        off = self.alloc(len(data) + 1)
+        self.buf[off:off + len(data)] = data
+        return off
+
+    def add_strings(self, strings):
+        struct.pack_into("<I", self.buf, self.alloc(4), len(strings))
+        array = self.alloc(4 * len(strings))
+        for i, s in enumerate(strings):
+            struct.pack_into("<I", self.buf, array + 4 * i, self.add_string(s))
+
+    def add_entry(self, name, context, type_):
+        off = self.alloc(16)
+        context_index = self.contexts.index(context) if context else 0xFFFFFFFF
+        type_index = self.types.index(type_) if type_ else 0xFFFFFFFF
+        struct.pack_into("<IIII", self.buf, off, self.add_string(name), len(name), context_index, type_index)
+        return off
+
+    def add_entries(self, entries):
+        array = self.alloc(4 * len(entries))
+        for i, (name, context, type_) in enumerate(entries):
+            struct.pack_into("<I", self.buf, array + 4 * i, self.add_entry(name, context, type_))
+        return array
+
+    def write_node(self, node):
+        off = self.alloc(28)
+        entry = self.add_entry(node.name, node.context, node.type)
+        prefixes = sorted(node.prefixes, key=lambda e: -len(e[0]))
+        prefix_array = self.add_entries(prefixes)
+        exact = sorted(node.exact, key=lambda e: e[0])
+        exact_array = self.add_entries(exact)
+        children = [node.children[name] for name in sorted(node.children)]
+        child_array = self.alloc(4 * len(children))
+        for i, child in enumerate(children):
+            struct.pack_into("<I", self.buf, child_array + 4 * i, self.write_node(child))
+        struct.pack_into("<7I", self.buf, off, entry, len(children), child_array, len(prefixes), prefix_array,
+                         len(exact), exact_array)
+        return off
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        raise SystemExit(__doc__.split("\n\n")[1])
+    rng = random.Random(int(sys.argv[3]) if len(sys.argv) == 4 else 1)
+    rules = random_rules(rng)
+    with open(sys.argv[2], "w") as f:
+        f.write("# generated by mkinfo.py\n")
+        for name, context, exact, type_ in rules:
+            f.write("%s %s %s%s\n" % (name, context, "exact" if exact else "prefix", " " + type_ if type_ else ""))
+
+    contexts = {DEFAULT_CONTEXT} | {r[1] for r in rules}
+    # a rule without a type still puts "" in the table, like StringPointerFromContainer() in AddToTrie()
+    types = {DEFAULT_TYPE} | {r[3] or "" for r in rules}
+    image = Image(contexts, types)
+    header = image.alloc(24)
+    contexts_offset = len(image.buf)
+    image.add_strings(image.contexts)
+    types_offset = len(image.buf)
+    image.add_strings(image.types)
+    root = image.write_node(build_trie(rules))
+    struct.pack_into("<6I", image.buf, header, 1, 1, len(image.buf), contexts_offset, types_offset, root)
+    with open(sys.argv[1], "wb") as f:
+        f.write(image.buf)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,171 @@
+/**
+ * usage: property_info_test INFO [CONTEXTS]
+ *
+ * Offline checks of property_info.cpp and property_info_builder.cpp against
+ * an image written by tests/mkinfo.py:
+ *
+ *   - PropertyInfoBuilder::load() of INFO serializes back to the same bytes;
+ *   - with CONTEXTS, the property_contexts INFO was built from,
+ *     load_contexts() serializes to the same bytes as well;
+ *   - batch_resolver gives the same context as get_context_index() for
+ *     names taken from every node, prefix and exact match of the trie, with
+ *     suffixes that match and miss, in sorted and in shuffled order.
+ *
+ * Prints one line per failed check and exits 1 when there was any.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "property_info.h"
+#include "property_info_builder.h"
+
+static int g_failures = 0;
+
+static void fail(const char *what, const char *path)
+{
+    printf("FAIL: %s [%s]\n", what, path);
+    g_failures++;
+}
+
+static std::string read_file(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// first differing byte, for the failure report
+static size_t first_difference(const std::string &a, const std::string &b)
+{
+    size_t i = 0;
+    while (i < a.size() && i < b.size() && a[i] == b[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+static void check_bytes(const std::string &expected, const std::string &got, const char *what, const char *path)
+{
+    if (got == expected)
+    {
+        return;
+    }
+    printf("  %zu bytes, want %zu, first difference at %zu\n", got.size(), expected.size(),
+           first_difference(expected, got));
+    fail(what, path);
+}
+
+// the names of a node, its prefixes and exact matches, each also with a suffix glued on and one more segment
+static void collect_names(property_node &node, const std::string &path, std::vector<std::string> *names)
+{
+    static const char *const suffixes[] = {"", "x", ".x", ".boot.x"};
+    std::vector<std::string> bases = {path.empty() ? std::string("x") : path.substr(0, path.size() - 1)};
+    for (property_entry &entry : node.get_prefixes())
+    {
+        bases.push_back(path + std::string(entry.name));
+    }
+    for (property_entry &entry : node.get_exact_matches())
+    {
+        bases.push_back(path + std::string(entry.name));
+    }
+    for (const std::string &base : bases)
+    {
+        for (const char *suffix : suffixes)
+        {
+            names->push_back(base + suffix);
+        }
+    }
+    for (property_node &child : node.get_children())
+    {
+        collect_names(child, path + std::string(child.get_entry().name) + ".", names);
+    }
+}
+
+static void check_resolver(property_info &info, const char *path)
+{
+    std::vector<std::string> names;
+    collect_names(info.get_root(), "", &names);
+    std::sort(names.begin(), names.end());
+    std::mt19937 rng(1);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        // sorted first, the order --verify feeds it, then shuffled
+        if (pass == 1)
+        {
+            std::shuffle(names.begin(), names.end(), rng);
+        }
+        property_info::batch_resolver resolver(&info);
+        size_t bad = 0;
+        for (const std::string &name : names)
+        {
+            uint32_t want = info.get_context_index(name.c_str());
+            uint32_t got = resolver.get_context_index(name.c_str());
+            if (got != want && bad++ < 5)
+            {
+                printf("  [%s]: batch_resolver %u, get_context_index %u\n", name.c_str(), got, want);
+            }
+        }
+        if (bad > 0)
+        {
+            fail(pass == 0 ? "batch_resolver, sorted names" : "batch_resolver, shuffled names", path);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3)
+    {
+        fprintf(stderr, "usage: property_info_test INFO [CONTEXTS]\n");
+        return 2;
+    }
+    const char *info_path = argv[1];
+    std::string image = read_file(info_path);
+    property_info info(info_path);
+    if (image.empty() || !info.is_valid())
+    {
+        fail("not a property_info image", info_path);
+        return 1;
+    }
+
+    PropertyInfoBuilder loaded;
+    if (loaded.load(info_path) != PROP_OK)
+    {
+        fail("PropertyInfoBuilder::load", info_path);
+    }
+    else
+    {
+        check_bytes(image, loaded.serialize(), "load() round trip", info_path);
+    }
+
+    if (argc == 3)
+    {
+        PropertyInfoBuilder built;
+        std::vector<std::string> errors;
+        prop_error err = built.load_contexts(argv[2], &errors);
+        for (const std::string &error : errors)
+        {
+            printf("  %s\n", error.c_str());
+        }
+        if (err != PROP_OK || !errors.empty())
+        {
+            fail("PropertyInfoBuilder::load_contexts", argv[2]);
+        }
+        else
+        {
+            check_bytes(image, built.serialize(), "load_contexts() against the image", argv[2]);
+        }
+    }
+
+    check_resolver(info, info_path);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#!/bin/sh
+# usage: stress_test.sh BINARY [PROCS [PER_PROC]]
+#
+# Concurrent writers against a generated root: PROCS processes create
+# PER_PROC properties each in the same area while others rewrite counters
+# there with wildcard -c and readers dump it. Afterwards every created
+# property must be there once with its value, the two counters set together
+# must agree, --verify must pass and no file may appear next to the areas.
+set -u
+BIN=$1
+PROCS=${2:-8}
+PER_PROC=${3:-40}
+HERE=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+ROOT=$TMP/root
+python3 "$HERE/mkfixture.py" "$ROOT" "$HERE/fixture.txt" || exit 1
+ls "$ROOT" >"$TMP/files.before"
+
+fail=0
+pids=
+for p in $(seq 1 "$PROCS"); do
+    (
+        for i in $(seq 1 "$PER_PROC"); do
+            "$BIN" --root "$ROOT" -y "sys.stress.p$p.k$i" "v$p.$i" >/dev/null 2>&1 || echo "create p$p k$i failed"
+        done
+    ) >"$TMP/create$p" &
+    pids="$pids $!"
+done
+for c in $(seq 1 $((PROCS / 2 + 1))); do
+    (
+        for i in $(seq 1 "$PER_PROC"); do
+            "$BIN" --root "$ROOT" -c $(((c * PER_PROC + i) % 1000)) 'sys.usb.*' >/dev/null 2>&1 || echo "count c$c i$i failed"
+        done
+    ) >"$TMP/count$c" &
+    pids="$pids $!"
+done
+for r in 1 2; do
+    (
+        for i in $(seq 1 "$PER_PROC"); do
+            "$BIN" --root "$ROOT" 'sys.*' >/dev/null 2>&1 || echo "dump r$r i$i failed"
+        done
+    ) >"$TMP/dump$r" &
+    pids="$pids $!"
+done
+for pid in $pids; do
+    wait "$pid"
+done
+if [ -n "$(cat "$TMP"/create* "$TMP"/count* "$TMP"/dump*)" ]; then
+    echo "FAIL: writers or readers reported errors:"
+    cat "$TMP"/create* "$TMP"/count* "$TMP"/dump* | head -20
+    fail=1
+fi
+
+for p in $(seq 1 "$PROCS"); do
+    for i in $(seq 1 "$PER_PROC"); do
+        echo "[sys.stress.p$p.k$i]: [v$p.$i]"
+    done
+done | sort >"$TMP/expected"
+"$BIN" --root "$ROOT" 'sys.stress.*' | sort >"$TMP/got"
+if ! cmp -s "$TMP/expected" "$TMP/got"; then
+    echo "FAIL: created properties differ ($(wc -l <"$TMP/got") of $(wc -l <"$TMP/expected")):"
+    diff "$TMP/expected" "$TMP/got" | head -20
+    fail=1
+fi
+
+counts=$("$BIN" --root "$ROOT" 'sys.usb.*' | sed -n 's/.*count: \([0-9]*\)$/\1/p' | sort -u | wc -l)
+if [ "$counts" -ne 1 ]; then
+    echo "FAIL: sys.usb.* counters disagree:"
+    "$BIN" --root "$ROOT" 'sys.usb.*'
+    fail=1
+fi
+
+if ! "$BIN" --root "$ROOT" --verify >"$TMP/verify" 2>&1; then
+    echo "FAIL: --verify: $(cat "$TMP/verify")"
+    fail=1
+fi
+
+ls "$ROOT" | diff "$TMP/files.before" - >"$TMP/files.diff" || {
+    echo "FAIL: files appeared in the root:"
+    cat "$TMP/files.diff"
+    fail=1
+}
+
+[ $fail -eq 0 ] && echo "stress_test: ok ($PROCS x $PER_PROC creates)"
+exit $fail
@@ -0,0 +1,71 @@
+#!/bin/sh
+# usage: wait_test.sh BINARY
+#
+# --wait with writers in other processes, against a generated root: waiters
+# for a property that exists, for one that a writer creates and for one that
+# never comes. Each must return the right exit code, and none of the writes
+# may move a prop_area serial word, which only init moves.
+set -u
+BIN=$1
+HERE=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+ROOT=$TMP/root
+python3 "$HERE/mkfixture.py" "$ROOT" "$HERE/fixture.txt" || exit 1
+
+serials()
+{
+    for area in "$ROOT"/*; do
+        case "${area##*/}" in
+            property_info) ;;
+            *) echo "${area##*/} $(od -An -tx4 -j4 -N4 "$area")" ;;
+        esac
+    done
+}
+
+fail=0
+check()
+{
+    if [ "$1" -ne "$2" ]; then
+        echo "FAIL: $3: exit $1, want $2"
+        fail=1
+    fi
+}
+
+before=$(serials)
+waiters=
+for i in 1 2 3 4; do
+    timeout 20 "$BIN" --root "$ROOT" --wait sys.boot_completed 1 --timeout 5000 >"$TMP/boot$i" 2>&1 &
+    waiters="$waiters $!"
+done
+timeout 20 "$BIN" --root "$ROOT" --wait sys.test.created yes --timeout 5000 >"$TMP/created" 2>&1 &
+created=$!
+timeout 20 "$BIN" --root "$ROOT" --wait sys.test.never --timeout 300 >"$TMP/never" 2>&1 &
+never=$!
+
+sleep 0.3
+"$BIN" --root "$ROOT" -y sys.boot_completed 1 >/dev/null
+check $? 0 "set sys.boot_completed"
+"$BIN" --root "$ROOT" -y sys.test.created yes >/dev/null
+check $? 0 "create sys.test.created"
+
+for pid in $waiters; do
+    wait "$pid"
+    check $? 0 "waiter $pid for sys.boot_completed"
+done
+wait "$created"
+check $? 0 "waiter for sys.test.created"
+wait "$never"
+check $? 1 "waiter for sys.test.never"
+grep -q '^\[sys.boot_completed\]: \[1\]$' "$TMP/boot1" || { echo "FAIL: waiter printed: $(cat "$TMP/boot1")"; fail=1; }
+
+after=$(serials)
+if [ "$before" != "$after" ]; then
+    echo "FAIL: serial words moved"
+    echo "$before" >"$TMP/before"
+    echo "$after" | diff "$TMP/before" -
+    fail=1
+fi
+
+[ $fail -eq 0 ] && echo "wait_test: ok"
+exit $fail